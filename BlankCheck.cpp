@@ -0,0 +1,96 @@
+#include "BlankCheck.hpp"
+#include "ExitCodes.hpp"
+#include "Logger.hpp"
+
+#include <cstring>
+#include <sstream>
+
+using std::ostringstream;
+
+#define ERASED_BYTE 0xFF
+
+CBlankCheck::CBlankCheck(const CBlockLayout & layout, const list<unsigned int> & blocks)
+    : mLayout(layout), mChecked(layout.getBlockCount(), false), mUsed(layout.getBlockCount(), false),
+      mFirstUsed(layout.getBlockCount(), 0), mRemaining(0), mReadLength(0), mOffset(0)
+{
+    list<unsigned int>::const_iterator it;
+    for (it = blocks.begin(); it != blocks.end(); ++it) {
+        if (*it >= mLayout.getBlockCount()) {
+            ostringstream os;
+            os << "Block number " << *it << " is out of range [0," << (mLayout.getBlockCount() - 1) << "]";
+            CLogger::error(os.str(), EXIT_MCU);
+        }
+        if (mChecked[*it])
+            continue;
+        mChecked[*it] = true;
+        ++mRemaining;
+        if (mLayout.getBlock(*it).end > mReadLength)
+            mReadLength = mLayout.getBlock(*it).end;
+    }
+}
+
+uint32_t
+CBlankCheck::getReadLength() const
+{
+    return mReadLength;
+}
+
+uint32_t
+CBlankCheck::findUsed(const uint8_t *data, uint32_t length) const
+{
+    // Compare 8 bytes at once, erased memory is the common case
+    uint32_t i = 0;
+    for (; i + sizeof(uint64_t) <= length; i += sizeof(uint64_t)) {
+        uint64_t w;
+        memcpy(&w, data + i, sizeof(w));
+        if (w != UINT64_MAX)
+            break;
+    }
+    for (; i < length; ++i) {
+        if (data[i] != ERASED_BYTE)
+            break;
+    }
+    return i;
+}
+
+void
+CBlankCheck::write(const uint8_t *data, uint32_t length)
+{
+    uint32_t end = mOffset + length;
+
+    // Received data may span several blocks
+    unsigned int b = mLayout.findBlock(mOffset);
+    for (; (b < mLayout.getBlockCount()) && (mLayout.getBlock(b).start < end); ++b) {
+        if (!mChecked[b] || mUsed[b])
+            continue;
+        const CImage::range_t & r = mLayout.getBlock(b);
+        uint32_t s = (r.start > mOffset) ? r.start : mOffset;
+        uint32_t t = (r.end < end) ? r.end : end;
+        uint32_t u = findUsed(data + (s - mOffset), t - s);
+        if (u < t - s) {
+            mUsed[b] = true;
+            mFirstUsed[b] = s + u;
+            --mRemaining;
+        }
+    }
+
+    mOffset = end;
+}
+
+bool
+CBlankCheck::isAborted() const
+{
+    return mRemaining == 0;
+}
+
+bool
+CBlankCheck::isBlank(unsigned int block) const
+{
+    return (block < mLayout.getBlockCount()) && mChecked[block] && !mUsed[block];
+}
+
+uint32_t
+CBlankCheck::getFirstUsed(unsigned int block) const
+{
+    return mFirstUsed[block];
+}
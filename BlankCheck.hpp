@@ -0,0 +1,42 @@
+#ifndef BLANK_CHECK_HPP
+#define BLANK_CHECK_HPP 1
+
+#include "DataSink.hpp"
+#include "BlockLayout.hpp"
+
+#include <cstdint>
+#include <list>
+#include <vector>
+
+using std::list;
+using std::vector;
+
+// Checks that blocks are erased while memory is read. The first byte
+// differing from erased value 0xFF is found for each checked block,
+// reading is aborted when all checked blocks are known to be used.
+class CBlankCheck : public CDataSink {
+private:
+    const CBlockLayout & mLayout;
+    vector<bool> mChecked;
+    vector<bool> mUsed;
+    vector<uint32_t> mFirstUsed;
+    unsigned int mRemaining;
+    uint32_t mReadLength;
+    uint32_t mOffset;
+
+    uint32_t findUsed(const uint8_t *data, uint32_t length) const;
+
+public:
+    CBlankCheck(const CBlockLayout & layout, const list<unsigned int> & blocks);
+
+    // Length of memory to be read from address 0 to check all blocks
+    uint32_t getReadLength() const;
+    void write(const uint8_t *data, uint32_t length);
+    bool isAborted() const;
+
+    bool isBlank(unsigned int block) const;
+    // Address of the first byte which is not erased, valid for used blocks
+    uint32_t getFirstUsed(unsigned int block) const;
+};
+
+#endif
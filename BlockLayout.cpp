@@ -0,0 +1,64 @@
+#include "BlockLayout.hpp"
+
+#include <algorithm>
+
+CBlockLayout::CBlockLayout(const list<uint32_t> & blockSizes)
+{
+    list<uint32_t>::const_iterator it;
+    uint32_t a = 0;
+
+    for (it = blockSizes.begin(); it != blockSizes.end(); ++it) {
+        CImage::range_t r;
+        r.start = a;
+        r.end = a + *it * 1024;
+        mBlocks.push_back(r);
+        a = r.end;
+    }
+}
+
+unsigned int
+CBlockLayout::getBlockCount() const
+{
+    return mBlocks.size();
+}
+
+const CImage::range_t &
+CBlockLayout::getBlock(unsigned int block) const
+{
+    return mBlocks.at(block);
+}
+
+uint32_t
+CBlockLayout::getSize() const
+{
+    return mBlocks.empty() ? 0 : mBlocks.back().end;
+}
+
+unsigned int
+CBlockLayout::findBlock(uint32_t address) const
+{
+    // First block ending after address
+    vector<CImage::range_t>::const_iterator it =
+        std::upper_bound(mBlocks.begin(), mBlocks.end(), address,
+                         [](uint32_t a, const CImage::range_t & r) { return a < r.end; });
+    return it - mBlocks.begin();
+}
+
+list<unsigned int>
+CBlockLayout::getBlocksWithData(const CImage & image) const
+{
+    list<unsigned int> blocks;
+    CImage::const_iterator it;
+
+    for (it = image.begin(); it != image.end(); ++it) {
+        const CImage::extent_t & e = it->second;
+        unsigned int first = findBlock(e.address);
+        unsigned int last = findBlock(e.address + e.length - 1);
+        // Extents are sorted, only the first block may repeat
+        if (!blocks.empty() && (blocks.back() == first))
+            ++first;
+        for (unsigned int i = first; (i <= last) && (i < mBlocks.size()); ++i)
+            blocks.push_back(i);
+    }
+    return blocks;
+}
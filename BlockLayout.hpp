@@ -0,0 +1,33 @@
+#ifndef BLOCK_LAYOUT_HPP
+#define BLOCK_LAYOUT_HPP 1
+
+#include "Image.hpp"
+
+#include <cstdint>
+#include <list>
+#include <vector>
+
+using std::list;
+using std::vector;
+
+// Division of FLASH memory into blocks (sectors) which are erased as a
+// whole, built from block sizes in KB as given by IMcuSpecifics
+class CBlockLayout {
+private:
+    // Blocks as address ranges in address order
+    vector<CImage::range_t> mBlocks;
+
+public:
+    CBlockLayout(const list<uint32_t> & blockSizes);
+
+    unsigned int getBlockCount() const;
+    const CImage::range_t & getBlock(unsigned int block) const;
+    uint32_t getSize() const;
+    // Number of block containing address, getBlockCount() when address
+    // lies behind the last block
+    unsigned int findBlock(uint32_t address) const;
+    // Blocks containing at least one byte of image data in address order
+    list<unsigned int> getBlocksWithData(const CImage & image) const;
+};
+
+#endif
@@ -0,0 +1,158 @@
+#include "DataSink.hpp"
+#include "ExitCodes.hpp"
+#include "Logger.hpp"
+
+#include <string.h>
+#include <errno.h>
+#ifdef UNIX
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#endif
+
+#include <sstream>
+
+using std::ostringstream;
+
+CBufferSink::CBufferSink(vector<uint8_t> & data)
+    : mData(data)
+{
+    ;
+}
+
+void
+CBufferSink::begin(uint32_t length)
+{
+    mData.clear();
+    mData.reserve(length);
+}
+
+void
+CBufferSink::write(const uint8_t *data, uint32_t length)
+{
+    mData.insert(mData.end(), data, data + length);
+}
+
+bool
+CFileSink::isStdout(const string & fpath)
+{
+    return !fpath.compare("-");
+}
+
+CFileSink::CFileSink(const string & fpath)
+    : mPath(fpath), mStdout(isStdout(fpath)), mComplete(false)
+{
+#ifdef UNIX
+    mOffset = 0;
+    if (mStdout) {
+        mFd = STDOUT_FILENO;
+        return;
+    }
+    struct stat st;
+    bool exists = (stat(fpath.c_str(), &st) == 0);
+    if (exists && !S_ISREG(st.st_mode)) {
+        mFd = open(fpath.c_str(), O_WRONLY | O_TRUNC);
+    } else {
+        ostringstream tp;
+        tp << fpath << "." << getpid() << ".tmp";
+        mTempPath = tp.str();
+        mFd = open(mTempPath.c_str(), O_WRONLY | O_CREAT | O_EXCL, 0666);
+        // Replaced file keeps its permissions
+        if ((mFd != -1) && exists)
+            fchmod(mFd, st.st_mode & 07777);
+    }
+    if (mFd == -1) {
+#else
+    if (mStdout) {
+        mFile = stdout;
+        return;
+    }
+    mTempPath = fpath + ".tmp";
+    if ((mFile = fopen(mTempPath.c_str(), "wb")) == NULL) {
+#endif
+        ostringstream os;
+        os << "Cannot open file for writing: " << fpath << ": " << strerror(errno);
+	CLogger::error(os.str(), EXIT_MAIN_FILE_INOUT);
+    }
+}
+
+CFileSink::~CFileSink()
+{
+    if (mStdout || mComplete)
+        return;
+#ifdef UNIX
+    close(mFd);
+#else
+    fclose(mFile);
+#endif
+    // Target file is left as it was
+    if (!mTempPath.empty())
+        remove(mTempPath.c_str());
+}
+
+void
+CFileSink::begin(uint32_t length)
+{
+#ifdef UNIX
+    // Reserve space at once, it is fragmented less and it fails early when
+    // disk is full. Not all file systems support it, ignore errors.
+    if (!mTempPath.empty() && (length > 0))
+        posix_fallocate(mFd, 0, length);
+#endif
+}
+
+void
+CFileSink::write(const uint8_t *data, uint32_t length)
+{
+#ifdef UNIX
+    while (length > 0) {
+        ssize_t r;
+        if (mStdout)
+            r = ::write(mFd, data, length);
+        else
+            r = pwrite(mFd, data, length, mOffset);
+        if (r < 0) {
+            if (errno == EINTR)
+                continue;
+            ostringstream os;
+            os << "Cannot write to file: " << mPath << ": " << strerror(errno);
+            CLogger::error(os.str(), EXIT_MAIN_FILE_INOUT);
+        }
+        data += r;
+        length -= r;
+        mOffset += r;
+    }
+#else
+    if (fwrite(data, sizeof(uint8_t), length, mFile) != length)
+	CLogger::error("Cannot write to file: " + mPath, EXIT_MAIN_FILE_INOUT);
+#endif
+}
+
+void
+CFileSink::end()
+{
+    if (mStdout) {
+        mComplete = true;
+        return;
+    }
+#ifdef UNIX
+    // Drop preallocated space beyond data
+    bool failed = (!mTempPath.empty() && (ftruncate(mFd, mOffset) != 0));
+    failed = (close(mFd) != 0) || failed;
+#else
+    bool failed = (fclose(mFile) != 0);
+    // Rename does not replace an existing file
+    if (!failed)
+        remove(mPath.c_str());
+#endif
+    if (!failed && !mTempPath.empty())
+        failed = (rename(mTempPath.c_str(), mPath.c_str()) != 0);
+    mComplete = true;
+    if (failed) {
+        ostringstream os;
+        os << "Cannot write to file: " << mPath << ": " << strerror(errno);
+        if (!mTempPath.empty())
+            remove(mTempPath.c_str());
+        CLogger::error(os.str(), EXIT_MAIN_FILE_INOUT);
+    }
+}
@@ -0,0 +1,65 @@
+#ifndef DATA_SINK_HPP
+#define DATA_SINK_HPP 1
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <stdio.h>
+
+using std::string;
+using std::vector;
+
+// Consumer of data read from MCU memory. Data are passed in order from
+// address 0 as soon as each block is received and checked.
+class CDataSink {
+public:
+    virtual ~CDataSink() { ; };
+
+    // Called once before any data with the total number of bytes
+    virtual void begin(uint32_t length) { ; };
+    virtual void write(const uint8_t *data, uint32_t length) = 0;
+    // Called once after the last data
+    virtual void end() { ; };
+    // Sink needs no more data, the rest is skipped and end() is not called
+    virtual bool isAborted() const { return false; };
+};
+
+// Collects data in memory
+class CBufferSink : public CDataSink {
+private:
+    vector<uint8_t> & mData;
+public:
+    CBufferSink(vector<uint8_t> & data);
+    void begin(uint32_t length);
+    void write(const uint8_t *data, uint32_t length);
+};
+
+// Writes data to a file or to standard output when file name is "-".
+// Regular file is written as a temporary file in the same directory which
+// replaces the file only when the transfer is complete, an existing file
+// is kept when it fails. Temporary file is preallocated to the total
+// length. Other files, e.g. devices, are written in place.
+class CFileSink : public CDataSink {
+private:
+    string mPath;
+    // Empty when the file is written in place
+    string mTempPath;
+    bool mStdout;
+    bool mComplete;
+#ifdef UNIX
+    int mFd;
+    off_t mOffset;
+#else
+    FILE *mFile;
+#endif
+public:
+    static bool isStdout(const string & fpath);
+
+    CFileSink(const string & fpath);
+    ~CFileSink();
+    void begin(uint32_t length);
+    void write(const uint8_t *data, uint32_t length);
+    void end();
+};
+
+#endif
@@ -0,0 +1,91 @@
+#include "DataSource.hpp"
+#include "ExitCodes.hpp"
+#include "Logger.hpp"
+
+#include <cstring>
+#include <sstream>
+
+using std::ostringstream;
+
+CMemorySource::CMemorySource(const uint8_t *data, uint32_t length)
+    : mData(data), mLength(length), mOffset(0)
+{
+    ;
+}
+
+const uint8_t *
+CMemorySource::next(uint32_t length)
+{
+    if (mOffset + length > mLength)
+        CLogger::error("Internal error: data requested beyond end of buffer", EXIT_MAIN_FILE_INOUT);
+    const uint8_t *p = mData + mOffset;
+    mOffset += length;
+    return p;
+}
+
+CStreamSource::CStreamSource(FILE *file, const string & name, vector<uint8_t> *keep)
+    : mFile(file), mName(name), mKeep(keep)
+{
+    ;
+}
+
+const uint8_t *
+CStreamSource::next(uint32_t length)
+{
+    mBlock.resize(length);
+    // Blocks until producer supplies whole block or closes the stream
+    size_t r = fread(mBlock.data(), 1, length, mFile);
+    if (r != length) {
+        ostringstream os;
+        if (ferror(mFile))
+            os << "Cannot read from file: " << mName;
+        else
+            os << "Unexpected end of data in " << mName;
+        CLogger::error(os.str(), EXIT_MAIN_FILE_INOUT);
+    }
+    if (mKeep)
+        mKeep->insert(mKeep->end(), mBlock.begin(), mBlock.end());
+    return mBlock.data();
+}
+
+CImageSource::CImageSource(const CImage & image)
+    : mImage(image), mOffset(0)
+{
+    ;
+}
+
+const uint8_t *
+CImageSource::next(uint32_t length)
+{
+    uint32_t a = mOffset;
+    const uint8_t *p = mImage.getContiguousData(a, length);
+
+    mOffset += length;
+    if (p)
+        return p;
+
+    mBlock.assign(length, 0xFF);
+    mImage.copyTo(a, mBlock.data(), length);
+    return mBlock.data();
+}
+
+COverlaySource::COverlaySource(CDataSource & base, const CImage & overlay)
+    : mBase(base), mOverlay(overlay), mOffset(0)
+{
+    ;
+}
+
+const uint8_t *
+COverlaySource::next(uint32_t length)
+{
+    const uint8_t *p = mBase.next(length);
+    uint32_t a = mOffset;
+
+    mOffset += length;
+    if (!mOverlay.hasDataIn(a, a + length))
+        return p;
+
+    mBlock.assign(p, p + length);
+    mOverlay.copyTo(a, mBlock.data(), length);
+    return mBlock.data();
+}
@@ -0,0 +1,73 @@
+#ifndef DATA_SOURCE_HPP
+#define DATA_SOURCE_HPP 1
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <stdio.h>
+
+#include "Image.hpp"
+
+using std::string;
+using std::vector;
+
+// Producer of data written to MCU memory. Data are requested in order from
+// address 0, one block at a time.
+class CDataSource {
+public:
+    virtual ~CDataSource() { ; };
+
+    // Next length bytes, valid until the following call
+    virtual const uint8_t * next(uint32_t length) = 0;
+};
+
+// Data in caller's memory, blocks are not copied
+class CMemorySource : public CDataSource {
+private:
+    const uint8_t *mData;
+    uint32_t mLength;
+    uint32_t mOffset;
+public:
+    CMemorySource(const uint8_t *data, uint32_t length);
+    const uint8_t * next(uint32_t length);
+};
+
+// Data read from a stream as they are needed, e.g. from a pipe. Optionally
+// all data read are kept for later use.
+class CStreamSource : public CDataSource {
+private:
+    FILE *mFile;
+    string mName;
+    vector<uint8_t> mBlock;
+    vector<uint8_t> *mKeep;
+public:
+    CStreamSource(FILE *file, const string & name, vector<uint8_t> *keep = 0);
+    const uint8_t * next(uint32_t length);
+};
+
+// Data of a sparse image, gaps are filled with erased value. Blocks lying
+// in a single extent are passed without a copy.
+class CImageSource : public CDataSource {
+private:
+    const CImage & mImage;
+    uint32_t mOffset;
+    vector<uint8_t> mBlock;
+public:
+    CImageSource(const CImage & image);
+    const uint8_t * next(uint32_t length);
+};
+
+// Data of another source with data of an overlay image written over them.
+// Blocks without overlay data are passed without a copy.
+class COverlaySource : public CDataSource {
+private:
+    CDataSource & mBase;
+    const CImage & mOverlay;
+    uint32_t mOffset;
+    vector<uint8_t> mBlock;
+public:
+    COverlaySource(CDataSource & base, const CImage & overlay);
+    const uint8_t * next(uint32_t length);
+};
+
+#endif
@@ -8,5 +8,7 @@
 #define EXIT_MAIN_SIGNAL      5
 #define EXIT_MCU              6
 #define EXIT_SERIAL_PORT      7
+#define EXIT_MAIN_STATION     8
+#define EXIT_MAIN_VERIFY_MISMATCH 9
 
 #endif
@@ -0,0 +1,90 @@
+#include "FileMapping.hpp"
+#include "ExitCodes.hpp"
+#include "Logger.hpp"
+
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#ifdef UNIX
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#endif
+
+#include <sstream>
+
+using std::ostringstream;
+
+#define FILE_READ_CHUNK (64 * 1024)
+
+CFileMapping::CFileMapping(const string & fpath)
+    : mData(0), mSize(0), mMapped(false)
+{
+    bool isStdin = !fpath.compare("-");
+#ifdef UNIX
+    if (!isStdin) {
+        int fd;
+        struct stat st;
+
+        if ((fd = open(fpath.c_str(), O_RDONLY)) == -1)
+            CLogger::error("Cannot open file for reading: " + fpath, EXIT_MAIN_FILE_INOUT);
+
+        if ((fstat(fd, &st) == 0) && S_ISREG(st.st_mode) && (st.st_size > 0)) {
+            void *p = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (p != MAP_FAILED) {
+                // Data are sent to MCU in order
+                madvise(p, st.st_size, MADV_SEQUENTIAL);
+                mData = (const uint8_t *) p;
+                mSize = st.st_size;
+                mMapped = true;
+            }
+        }
+        close(fd);
+        if (mMapped)
+            return;
+    }
+#endif
+    // Read until end of file, size of pipes and devices is not known
+    FILE *f = stdin;
+
+    if (!isStdin && ((f = fopen(fpath.c_str(), "rb")) == NULL))
+	CLogger::error("Cannot open file for reading: " + fpath, EXIT_MAIN_FILE_INOUT);
+
+    for (;;) {
+        size_t n = mBuffer.size();
+        mBuffer.resize(n + FILE_READ_CHUNK);
+        size_t r = fread(mBuffer.data() + n, 1, FILE_READ_CHUNK, f);
+        mBuffer.resize(n + r);
+        if (r < FILE_READ_CHUNK)
+            break;
+    }
+    bool failed = ferror(f);
+    if (!isStdin)
+        fclose(f);
+    if (failed)
+        CLogger::error("Cannot read from file: " + fpath, EXIT_MAIN_FILE_INOUT);
+
+    mData = mBuffer.data();
+    mSize = mBuffer.size();
+}
+
+CFileMapping::~CFileMapping()
+{
+#ifdef UNIX
+    if (mMapped)
+        munmap((void *) mData, mSize);
+#endif
+}
+
+const uint8_t *
+CFileMapping::data() const
+{
+    return mData;
+}
+
+size_t
+CFileMapping::size() const
+{
+    return mSize;
+}
@@ -0,0 +1,32 @@
+#ifndef FILE_MAPPING_HPP
+#define FILE_MAPPING_HPP 1
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+// Read-only content of a whole file. Regular files are mapped to memory,
+// other files (and all files on platforms without mmap) are read once
+// into a buffer. File name "-" stands for standard input.
+class CFileMapping {
+private:
+    const uint8_t *mData;
+    size_t mSize;
+    bool mMapped;
+    vector<uint8_t> mBuffer;
+
+    CFileMapping(const CFileMapping &) = delete;
+    CFileMapping & operator=(const CFileMapping &) = delete;
+
+public:
+    CFileMapping(const string & fpath);
+    ~CFileMapping();
+
+    const uint8_t * data() const;
+    size_t size() const;
+};
+
+#endif
@@ -0,0 +1,100 @@
+#include "HexFile.hpp"
+#include "ExitCodes.hpp"
+#include "Logger.hpp"
+
+#define HEX_MAX_DATA     255
+
+#define HEX_RECORD_DATA           0x00
+#define HEX_RECORD_EOF            0x01
+#define HEX_RECORD_EXT_SEGMENT    0x02
+#define HEX_RECORD_START_SEGMENT  0x03
+#define HEX_RECORD_EXT_LINEAR     0x04
+#define HEX_RECORD_START_LINEAR   0x05
+
+bool
+CHexFile::hasHexExtension(const string & fpath)
+{
+    static const char * const ext[] = { ".hex", ".HEX", ".ihx", ".IHX", ".h86", ".H86", 0 };
+    return hasExtension(fpath, ext);
+}
+
+CHexFile::CHexFile(const string & fpath)
+    : CRecordFile(fpath), mBaseAddress(0), mEof(false)
+{
+    ;
+}
+
+void
+CHexFile::finish()
+{
+    if (!mEof)
+        CLogger::warning("File " + mPath + " has no end of file record");
+}
+
+void
+CHexFile::parseRecord(const char *s, size_t length, CImage & image)
+{
+    uint8_t b[HEX_MAX_DATA + 5];
+
+    // Ignore line ending and empty lines
+    while ((length > 0) && ((s[length - 1] == '\r') || (s[length - 1] == ' ') || (s[length - 1] == '\t')))
+        --length;
+    if (length == 0)
+        return;
+    if (mEof)
+        recordError("Data after end of file record");
+    if (s[0] != ':')
+        recordError("Record does not start with ':'");
+    if (((length - 1) % 2 != 0) || (length < 11))
+        recordError("Bad record length");
+
+    // Decode bytes: count, address (2), type, data, checksum
+    size_t n = (length - 1) / 2;
+    if (n > sizeof(b))
+        recordError("Bad record length");
+    decodeBytes(s + 1, n, b);
+    uint8_t sum = 0;
+    for (size_t i = 0; i < n; ++i)
+        sum += b[i];
+    if (b[0] + 5u != n)
+        recordError("Byte count does not match record length");
+    if (sum != 0)
+        recordError("Bad checksum");
+
+    uint8_t count = b[0];
+    uint16_t offset = (b[1] << 8) | b[2];
+    uint8_t *data = b + 4;
+
+    switch (b[3]) {
+    case HEX_RECORD_DATA:
+        // Offset wraps around within 64 KB segment
+        if (offset + count > 0x10000u) {
+            uint32_t first = 0x10000u - offset;
+            image.addData(mBaseAddress + offset, data, first);
+            image.addData(mBaseAddress, data + first, count - first);
+        } else {
+            image.addData(mBaseAddress + offset, data, count);
+        }
+        break;
+    case HEX_RECORD_EOF:
+        mEof = true;
+        break;
+    case HEX_RECORD_EXT_SEGMENT:
+        if (count != 2)
+            recordError("Bad extended segment address record");
+        mBaseAddress = ((data[0] << 8) | data[1]) << 4;
+        break;
+    case HEX_RECORD_EXT_LINEAR:
+        if (count != 2)
+            recordError("Bad extended linear address record");
+        mBaseAddress = ((uint32_t) ((data[0] << 8) | data[1])) << 16;
+        break;
+    case HEX_RECORD_START_SEGMENT:
+    case HEX_RECORD_START_LINEAR:
+        // Start address has no meaning for FLASH memory
+        break;
+    default:
+        recordError("Unknown record type " + CLogger::decToHex(b[3]));
+        break;
+    }
+}
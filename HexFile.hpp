@@ -0,0 +1,22 @@
+#ifndef HEX_FILE_HPP
+#define HEX_FILE_HPP 1
+
+#include "RecordFile.hpp"
+
+// Intel HEX reader including HEX86 extended segment and extended linear
+// address records
+class CHexFile : public CRecordFile {
+private:
+    uint32_t mBaseAddress;
+    bool mEof;
+
+    void parseRecord(const char *s, size_t length, CImage & image);
+    void finish();
+
+public:
+    static bool hasHexExtension(const string & fpath);
+
+    CHexFile(const string & fpath);
+};
+
+#endif
@@ -0,0 +1,327 @@
+#include "Image.hpp"
+#include "ExitCodes.hpp"
+#include "Logger.hpp"
+
+#include <cstring>
+#include <sstream>
+#include <iterator>
+
+using std::ostringstream;
+
+CImage::CImage()
+{
+    mHasOpenExtent = false;
+}
+
+void
+CImage::clear()
+{
+    mExtents.clear();
+    mBuffers.clear();
+    mMappings.clear();
+    mHasOpenExtent = false;
+}
+
+map<uint32_t, CImage::extent_t>::iterator
+CImage::findInsertPosition(uint32_t address, uint64_t length)
+{
+    if (address + length > 0x100000000ull) {
+        ostringstream os;
+        os << "Data at address " << CLogger::decToHex(address) << " exceed 4 GB address space";
+        CLogger::error(os.str(), EXIT_MAIN_FILE_INOUT);
+    }
+
+    // Check overlap with the preceding and the following extent
+    map<uint32_t, extent_t>::iterator next = mExtents.lower_bound(address);
+    if (((next != mExtents.end()) && (next->first < address + length))
+        || ((next != mExtents.begin())
+            && (std::prev(next)->second.address + std::prev(next)->second.length > address))) {
+        ostringstream os;
+        os << "Data at address " << CLogger::decToHex(address) << " overlap already defined data";
+        CLogger::error(os.str(), EXIT_MAIN_FILE_INOUT);
+    }
+    return next;
+}
+
+void
+CImage::addData(uint32_t address, const uint8_t *data, uint32_t length)
+{
+    if (length == 0)
+        return;
+
+    map<uint32_t, extent_t>::iterator next = findInsertPosition(address, length);
+
+    // Data continuing the open extent are appended to its buffer
+    if (mHasOpenExtent
+        && (mOpenExtent->second.address + mOpenExtent->second.length == address)) {
+        vector<uint8_t> & b = mBuffers.back();
+        b.insert(b.end(), data, data + length);
+        mOpenExtent->second.data = b.data();
+        mOpenExtent->second.length += length;
+        return;
+    }
+
+    mBuffers.push_back(vector<uint8_t>(data, data + length));
+    extent_t e;
+    e.address = address;
+    e.length = length;
+    e.data = mBuffers.back().data();
+    mOpenExtent = mExtents.insert(next, std::make_pair(address, e));
+    mHasOpenExtent = true;
+}
+
+void
+CImage::addData(uint32_t address, std::unique_ptr<CFileMapping> mapping)
+{
+    if (mapping->size() == 0)
+        return;
+
+    map<uint32_t, extent_t>::iterator next = findInsertPosition(address, mapping->size());
+
+    extent_t e;
+    e.address = address;
+    e.length = mapping->size();
+    e.data = mapping->data();
+    mExtents.insert(next, std::make_pair(address, e));
+    mMappings.push_back(std::move(mapping));
+    // Following data can not be appended to the mapping
+    mHasOpenExtent = false;
+}
+
+bool
+CImage::overlaps(const CImage & other, uint32_t & address) const
+{
+    const_iterator it;
+
+    for (it = other.mExtents.begin(); it != other.mExtents.end(); ++it) {
+        const extent_t & e = it->second;
+        const_iterator next = mExtents.lower_bound(e.address);
+        if ((next != mExtents.end()) && (next->first < e.address + e.length)) {
+            address = next->first;
+            return true;
+        }
+        if ((next != mExtents.begin())
+            && (std::prev(next)->second.address + std::prev(next)->second.length > e.address)) {
+            address = e.address;
+            return true;
+        }
+    }
+    return false;
+}
+
+void
+CImage::merge(CImage & other)
+{
+    map<uint32_t, extent_t>::const_iterator it;
+
+    for (it = other.mExtents.begin(); it != other.mExtents.end(); ++it)
+        findInsertPosition(it->first, it->second.length);
+
+    // Extent data stay in place, only their owners move
+    mExtents.insert(other.mExtents.begin(), other.mExtents.end());
+    mBuffers.splice(mBuffers.end(), other.mBuffers);
+    mMappings.splice(mMappings.end(), other.mMappings);
+    mHasOpenExtent = false;
+    other.clear();
+}
+
+void
+CImage::remove(uint32_t startAddr, uint32_t endAddr)
+{
+    map<uint32_t, extent_t>::iterator it = mExtents.upper_bound(startAddr);
+
+    if (startAddr >= endAddr)
+        return;
+    // Open extent may be split
+    mHasOpenExtent = false;
+
+    if (it != mExtents.begin())
+        --it;
+    while ((it != mExtents.end()) && (it->first < endAddr)) {
+        extent_t e = it->second;
+        uint32_t end = e.address + e.length;
+        if (end <= startAddr) {
+            ++it;
+            continue;
+        }
+        // Keep parts before and after the range, they share extent data
+        it = mExtents.erase(it);
+        if (e.address < startAddr) {
+            extent_t l = e;
+            l.length = startAddr - e.address;
+            mExtents.insert(std::make_pair(l.address, l));
+        }
+        if (end > endAddr) {
+            extent_t r;
+            r.address = endAddr;
+            r.length = end - endAddr;
+            r.data = e.data + (endAddr - e.address);
+            it = mExtents.insert(std::make_pair(r.address, r)).first;
+        }
+    }
+}
+
+void
+CImage::overlay(CImage & other)
+{
+    const_iterator it;
+
+    for (it = other.mExtents.begin(); it != other.mExtents.end(); ++it)
+        remove(it->second.address, it->second.address + it->second.length);
+    merge(other);
+}
+
+list<CImage::range_t>
+CImage::diff(const CImage & other) const
+{
+    list<range_t> ranges;
+    const_iterator it;
+
+    // Add single different byte, adjacent ones make one range
+    auto differs = [&ranges](uint32_t a, uint32_t n) {
+        if (!ranges.empty() && (ranges.back().end == a)) {
+            ranges.back().end += n;
+        } else {
+            range_t r;
+            r.start = a;
+            r.end = a + n;
+            ranges.push_back(r);
+        }
+    };
+
+    for (it = mExtents.begin(); it != mExtents.end(); ++it) {
+        const extent_t & e = it->second;
+        uint32_t a = e.address;
+        uint32_t end = e.address + e.length;
+
+        while (a < end) {
+            // Extent of other image containing a or the following one
+            const_iterator o = other.mExtents.upper_bound(a);
+            if ((o != other.mExtents.begin())
+                && (std::prev(o)->second.address + std::prev(o)->second.length > a))
+                --o;
+            if ((o == other.mExtents.end()) || (o->first >= end)) {
+                differs(a, end - a);
+                break;
+            }
+            if (o->first > a) {
+                differs(a, o->first - a);
+                a = o->first;
+            }
+            const extent_t & oe = o->second;
+            uint32_t b = (oe.address + oe.length < end) ? oe.address + oe.length : end;
+            const uint8_t *p = e.data + (a - e.address);
+            const uint8_t *q = oe.data + (a - oe.address);
+            for (uint32_t i = 0; i < b - a; ++i) {
+                if (p[i] != q[i])
+                    differs(a + i, 1);
+            }
+            a = b;
+        }
+    }
+    return ranges;
+}
+
+CImage::const_iterator
+CImage::begin() const
+{
+    return mExtents.begin();
+}
+
+CImage::const_iterator
+CImage::end() const
+{
+    return mExtents.end();
+}
+
+CImage::const_iterator
+CImage::findExtent(uint32_t address) const
+{
+    const_iterator it = mExtents.upper_bound(address);
+
+    if ((it != mExtents.begin())
+        && (std::prev(it)->second.address + std::prev(it)->second.length > address))
+        --it;
+    return it;
+}
+
+bool
+CImage::empty() const
+{
+    return mExtents.empty();
+}
+
+unsigned int
+CImage::getExtentCount() const
+{
+    return mExtents.size();
+}
+
+uint32_t
+CImage::getStartAddress() const
+{
+    return mExtents.empty() ? 0 : mExtents.begin()->first;
+}
+
+uint32_t
+CImage::getEndAddress() const
+{
+    if (mExtents.empty())
+        return 0;
+    const extent_t & e = mExtents.rbegin()->second;
+    return e.address + e.length;
+}
+
+uint32_t
+CImage::getDataSize() const
+{
+    uint32_t s = 0;
+    const_iterator it;
+
+    for (it = mExtents.begin(); it != mExtents.end(); ++it)
+        s += it->second.length;
+
+    return s;
+}
+
+bool
+CImage::hasDataIn(uint32_t startAddr, uint32_t endAddr) const
+{
+    // Extent starting before endAddr and ending after startAddr
+    const_iterator it = mExtents.lower_bound(endAddr);
+    if (it == mExtents.begin())
+        return false;
+    --it;
+    return (it->second.address + it->second.length > startAddr);
+}
+
+void
+CImage::copyTo(uint32_t address, uint8_t *buffer, uint32_t length) const
+{
+    uint32_t end = address + length;
+    const_iterator it = mExtents.upper_bound(address);
+
+    if (it != mExtents.begin())
+        --it;
+    for ( ; (it != mExtents.end()) && (it->first < end); ++it) {
+        const extent_t & e = it->second;
+        uint32_t a = (e.address > address) ? e.address : address;
+        uint32_t b = (e.address + e.length < end) ? e.address + e.length : end;
+        if (a < b)
+            memcpy(buffer + (a - address), e.data + (a - e.address), b - a);
+    }
+}
+
+const uint8_t *
+CImage::getContiguousData(uint32_t address, uint32_t length) const
+{
+    const_iterator it = mExtents.upper_bound(address);
+
+    if (it == mExtents.begin())
+        return 0;
+    --it;
+    const extent_t & e = it->second;
+    if ((uint64_t) address + length > (uint64_t) e.address + e.length)
+        return 0;
+    return e.data + (address - e.address);
+}
@@ -0,0 +1,85 @@
+#ifndef IMAGE_HPP
+#define IMAGE_HPP 1
+
+#include <cstdint>
+#include <map>
+#include <list>
+#include <vector>
+#include <memory>
+
+#include "FileMapping.hpp"
+
+using std::map;
+using std::list;
+using std::vector;
+
+// Sparse memory image. Data are kept as sorted, non-overlapping extents,
+// gaps between them are not materialized.
+class CImage {
+public:
+    typedef struct {
+        uint32_t address;
+        uint32_t length;
+        const uint8_t *data;
+    } extent_t;
+
+    // Address range [start, end)
+    typedef struct {
+        uint32_t start;
+        uint32_t end;
+    } range_t;
+
+    typedef map<uint32_t, extent_t>::const_iterator const_iterator;
+
+private:
+    // Extents by start address
+    map<uint32_t, extent_t> mExtents;
+    // Storage of extent data
+    list< vector<uint8_t> > mBuffers;
+    // Files whose content is referenced by extents without a copy
+    list< std::unique_ptr<CFileMapping> > mMappings;
+    // Extent which grows in the last buffer when data are added in order
+    map<uint32_t, extent_t>::iterator mOpenExtent;
+    bool mHasOpenExtent;
+
+    map<uint32_t, extent_t>::iterator findInsertPosition(uint32_t address, uint64_t length);
+
+    CImage(const CImage &) = delete;
+    CImage & operator=(const CImage &) = delete;
+
+public:
+    CImage();
+
+    void addData(uint32_t address, const uint8_t *data, uint32_t length);
+    // Add whole file content without copying it
+    void addData(uint32_t address, std::unique_ptr<CFileMapping> mapping);
+    void clear();
+    // Move all data of other image to this one. Data must not overlap.
+    void merge(CImage & other);
+    // Move all data of other image to this one, they replace data of this
+    // image where both overlap
+    void overlay(CImage & other);
+    // Drop data in the range
+    void remove(uint32_t startAddr, uint32_t endAddr);
+    // Ranges of this image's data which other image does not have or has
+    // with different value
+    list<range_t> diff(const CImage & other) const;
+    // Find first address where data of both images overlap
+    bool overlaps(const CImage & other, uint32_t & address) const;
+
+    const_iterator begin() const;
+    const_iterator end() const;
+    // Extent containing address or the following one
+    const_iterator findExtent(uint32_t address) const;
+    bool empty() const;
+    unsigned int getExtentCount() const;
+    uint32_t getStartAddress() const;
+    uint32_t getEndAddress() const;
+    uint32_t getDataSize() const;
+    bool hasDataIn(uint32_t startAddr, uint32_t endAddr) const;
+    void copyTo(uint32_t address, uint8_t *buffer, uint32_t length) const;
+    // Data of the range when it lies in a single extent, otherwise 0
+    const uint8_t * getContiguousData(uint32_t address, uint32_t length) const;
+};
+
+#endif
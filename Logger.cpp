@@ -9,21 +9,30 @@ using std::flush;
 using std::hex;
 using std::uppercase;
 using std::ostringstream;
+using std::mutex;
+using std::lock_guard;
 
 bool CLogger::mLogInfo = false;
 int CLogger::mProgressLastPercent = -1;
+mutex CLogger::mOutputMutex;
+thread_local string CLogger::mPrefix;
+std::ostream * CLogger::mOut = &cout;
 
 void
 CLogger::error(const string & msg, int returnValue)
 {
-    cerr << "ERROR:  " << msg << endl;
+    {
+        lock_guard<mutex> lock(mOutputMutex);
+        cerr << mPrefix << "ERROR:  " << msg << endl;
+    }
     throw CExitException(msg, returnValue);
 }
 
 void
 CLogger::warning(const string & msg)
 {
-    cerr << "WARNING:  " << msg << endl; 
+    lock_guard<mutex> lock(mOutputMutex);
+    cerr << mPrefix << "WARNING:  " << msg << endl; 
 }
 
 void
@@ -31,7 +40,15 @@ CLogger::info(const string & msg)
 {
     if (!CLogger::mLogInfo)
  	return;
-    cout << "INFO:  " << msg << endl; 
+    lock_guard<mutex> lock(mOutputMutex);
+    *mOut << mPrefix << "INFO:  " << msg << endl; 
+}
+
+void
+CLogger::message(const string & msg)
+{
+    lock_guard<mutex> lock(mOutputMutex);
+    *mOut << mPrefix << msg << endl; 
 }
 
 void
@@ -50,7 +67,7 @@ CLogger::progress(uint32_t b, uint32_t n)
     if (((p == 0) && (p != mProgressLastPercent))
         || ((p == 100) && (p != mProgressLastPercent))
         || ((p - mProgressLastPercent) >= LOGGER_PROGRESS_UNIT)) {
-        cout << p << "% (" << b << " B / " << n << " B)" << endl;
+        *mOut << p << "% (" << b << " B / " << n << " B)" << endl;
         mProgressLastPercent = p;
     }
     
@@ -58,12 +75,24 @@ CLogger::progress(uint32_t b, uint32_t n)
         mProgressLastPercent = -1;
 }
 
+void
+CLogger::setMessagesToStderr(bool b)
+{
+    mOut = b ? &cerr : &cout;
+}
+
 void
 CLogger::setLogInfo(bool b)
 {
     mLogInfo = b;
 }
 
+void
+CLogger::setPrefix(const string & prefix)
+{
+    mPrefix = prefix;
+}
+
 string
 CLogger::decToHex(int dec)
 {
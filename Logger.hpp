@@ -2,6 +2,7 @@
 #define LOGGER_HPP 1
 
 #include <iostream>
+#include <mutex>
 
 using std::string;
 
@@ -11,12 +12,23 @@ class CLogger {
 private:
     static bool mLogInfo;
     static int mProgressLastPercent;
+    // Serializes output of concurrently running jobs
+    static std::mutex mOutputMutex;
+    // Prefix of messages logged by the current thread
+    static thread_local string mPrefix;
+    // Stream of informational messages and progress
+    static std::ostream * mOut;
 public:
     static void error(const string & msg, int returnValue);
     static void warning(const string & msg);
     static void info(const string & msg);
+    static void message(const string & msg);
     static void progress(uint32_t b, uint32_t n);
     static void setLogInfo(bool b);
+    static void setPrefix(const string & prefix);
+    // Send informational messages to standard error output, standard
+    // output then carries only data
+    static void setMessagesToStderr(bool b);
     static string decToHex(int dec);
 };
 
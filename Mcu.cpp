@@ -4,18 +4,23 @@
 #include "fw_ident.hpp"
 #include "ExitCodes.hpp"
 #include "Logger.hpp"
+#include "BlockLayout.hpp"
 #include "ExitException.hpp"
+#include "Timeline.hpp"
+#include "WriteEstimate.hpp"
 #include "McuSt10f269.hpp"
 #include "McuSt10f168.hpp"
 
 #include <sstream>
+#include <chrono>
+#include <cctype>
 
 using FwCommon::fw_stage_1;
 using FwCommon::fw_stage_1_length;
 using FwCommon::fw_ident;
 using FwCommon::fw_ident_length;
 using std::ostringstream;
-using std::nothrow;
+namespace chrono = std::chrono;
 
 #define FW_1_MAX_LENGTH   32
 #define FW_MAX_LENGTH     2048
@@ -34,71 +39,211 @@ using std::nothrow;
 #define RET_SERIAL_OVERRUN  0x20
 #define RET_BAD_ECHO        0x21
 
-#define JUNK_BYTE_COUNT   128
+#define RESYNC_ATTEMPTS       4
+#define RESYNC_IDLE_TIMEOUT   20   // ms
+#define RESYNC_PING_TIMEOUT   250  // ms
 
+#define CATEGORY "mcu"
 
-CMcu::CMcu(CSerialPort & serialPort, float mcuFrequency)
-    : mSerialPort(serialPort), mMcuFrequency(mcuFrequency)
+
+CMcu::CMcu(CSerialPort & serialPort, float mcuFrequency, const CResetSequence * resetSequence)
+    : mSerialPort(serialPort), mMcuFrequency(mcuFrequency), mPhase(PHASE_CONNECTED),
+      mResyncPending(false)
 {
-    // Check in which mode MCU is
-    CLogger::info("Sending zero byte");	
-    uint8_t ack = CMD_PING;
-    // Send zero byte
-    mSerialPort.write(&ack, 1, 1);
-    // Read response
-    mSerialPort.read(&ack, 1);
+    CTimelineSpan span("connect", CATEGORY);
+    uint8_t ack;
+    bool acked;
+
+    mLineErrors = serial_line_errors_t();
 
-    // If some unknown data were received, try to read out junk bytes from
-    // previous operations without collected return status
-    for (int i = 0; (ack != BOOTSTRAP_ACK) && (ack != SHELL_ACK) && (i < JUNK_BYTE_COUNT); ++i) {
-        mSerialPort.read(&ack, 1);
+    if (resetSequence != 0) {
+        CTimelineSpan reset("reset sequence", CATEGORY);
+        resetSequence->apply(mSerialPort);
+    }
+    acked = ping(ack);
+    if (!acked && (resetSequence != 0)) {
+        CLogger::info("No response after reset, resetting MCU again");
+        CTimeline::mark("reset again", "retry");
+        resetSequence->apply(mSerialPort);
+        acked = ping(ack);
     }
+    if (!acked)
+        CLogger::error("Timeout occured while reading data from serial port", EXIT_SERIAL_PORT);
 
-    uint16_t idchip, idmanuf;
-    uint8_t data[4];
+    // If some unknown data were received, MCU is probably still sending
+    // data of an unfinished operation
+    if ((ack != BOOTSTRAP_ACK) && (ack != SHELL_ACK))
+        ack = resync();
+
+    // Garbage received while MCU resets is not counted to blocks
+    sampleLineErrors();
 
-    if (ack == SHELL_ACK) {
+    mBootstrap = (ack == BOOTSTRAP_ACK);
+    if (mBootstrap)
+        CLogger::info("Received bootstrap loader ACK byte " + CLogger::decToHex(ack));
+    else
         CLogger::info("Received stage 2 firmware ACK byte " + CLogger::decToHex(ack));
-        CLogger::info("Skipping MCU initialization, NOT LOADING stage 2 firmware");
+}
 
-        // Get IDCHIP and IDMANUF registers using Ident command for initialized MCU        
-        CLogger::info("Getting IDMAUNF and IDCHIP registers of already initialized MCU");    
-        
-        mSerialPort.sendSafeByte(CMD_IDENTIFY);
-        mSerialPort.read(data, 4);
-        decodeIdentData(data, idchip, idmanuf);
+unique_ptr<IMcuSpecifics>
+CMcu::getMcuSpecificsByName(const string & name)
+{
+    string n = name;
+    for (string::iterator it = n.begin(); it != n.end(); ++it)
+        *it = toupper(*it);
+
+    unique_ptr<IMcuSpecifics> s(new CMcuSt10f269());
+    if (s->getName() == n)
+        return s;
+    s.reset(new CMcuSt10f168());
+    if (s->getName() == n)
+        return s;
+    return unique_ptr<IMcuSpecifics>();
+}
 
-        setMcuSpecificsById(idchip, idmanuf);
-    } else if (ack == BOOTSTRAP_ACK) {
-        // Ziskame identifikaciu a nahrame shell  mcuSpecfics
-        CLogger::info("Received bootstrap loader ACK byte " + CLogger::decToHex(ack));
+uint16_t
+CMcu::getEraseMask(const list<unsigned int> & blockList, unsigned int blockCount)
+{
+    uint16_t mask = 0;
+    list<unsigned int>::const_iterator it;
+
+    for (it = blockList.begin(); it != blockList.end(); ++it) {
+        if (*it >= blockCount) {
+            ostringstream os;
+            os << "Block number " << *it << " is out of range [0," << (blockCount - 1) << "]";
+            CLogger::error(os.str(), EXIT_MCU);
+        }
+        mask |= 1 << *it;
+    }
+    return mask;
+}
+
+void
+CMcu::getLoaderLength(IMcuSpecifics & specifics, uint32_t & length, uint32_t & padding)
+{
+    // Stage 1 loader, ident firmware and stage 2 firmware
+    length = FW_1_MAX_LENGTH + 2 * FW_MAX_LENGTH;
+    padding = length - fw_stage_1_length - fw_ident_length - specifics.getFirmwareLength();
+}
 
+void
+CMcu::advanceTo(phase_t phase)
+{
+    if ((mPhase < PHASE_IDENTIFIED) && (phase >= PHASE_IDENTIFIED))
+        identify();
+    if ((mPhase < PHASE_SHELL_LOADED) && (phase >= PHASE_SHELL_LOADED))
+        loadShell();
+}
+
+void
+CMcu::identify()
+{
+    CTimelineSpan span("identify", CATEGORY);
+    uint16_t idmanuf, idchip;
+    uint8_t data[4];
+
+    if (mBootstrap) {
         // Write the first stage loader
         CLogger::info("Writing stage 1 firmware");
-        mSerialPort.write(fw_stage_1, fw_stage_1_length, FW_1_MAX_LENGTH);
+        {
+            CTimelineSpan upload("stage 1 upload", CATEGORY, FW_1_MAX_LENGTH);
+            mSerialPort.write(fw_stage_1, fw_stage_1_length, FW_1_MAX_LENGTH);
+        }
         
-        // Get identification
+        // Get identification. Ident firmware returns to the first stage
+        // loader which then waits for the stage 2 firmware.
         CLogger::info("Getting IDMAUNF and IDCHIP registers");
+        CTimelineSpan upload("ident upload", CATEGORY, FW_MAX_LENGTH);
         mSerialPort.write(fw_ident, fw_ident_length, FW_MAX_LENGTH);
-        mSerialPort.read(data, 4);
+    } else {
+        // Get IDCHIP and IDMANUF registers using Ident command for initialized MCU        
+        CLogger::info("Getting IDMAUNF and IDCHIP registers of already initialized MCU");    
+        mSerialPort.sendSafeByte(CMD_IDENTIFY);
+    }
+    mSerialPort.read(data, 4);
 
-        decodeIdentData(data, idchip, idmanuf);    
-        setMcuSpecificsById(idchip, idmanuf);
+    decodeIdentData(data, idmanuf, idchip);
+    setMcuSpecificsById(idmanuf, idchip);
+    mPhase = PHASE_IDENTIFIED;
+}
 
+void
+CMcu::loadShell()
+{
+    if (!mBootstrap) {
+        CLogger::info("Skipping MCU initialization, NOT LOADING stage 2 firmware");
+    } else {
         // Load stage 2 firmware
         CLogger::info("Writing stage 2 firmware");
+        CTimelineSpan upload("stage 2 upload", CATEGORY, FW_MAX_LENGTH);
         mSerialPort.write(mMcuSpecifics->getFirmware(),
                           mMcuSpecifics->getFirmwareLength(), FW_MAX_LENGTH);
         // Wait for initialization end
         uint16_t r = mSerialPort.readWord();
+        string e = checkLineErrors("stage 2 upload");
         if (r != 0x00) {
-            CLogger::error("Cannot initialize MCU: " + getMessageForRetCode(r), EXIT_MCU);
+            CLogger::error("Cannot initialize MCU: " + getMessageForRetCode(r) + e, EXIT_MCU);
         }
+    }
+    mPhase = PHASE_SHELL_LOADED;
+}
+
+void
+CMcu::init()
+{
+    advanceTo(PHASE_SHELL_LOADED);
+}
+
+bool
+CMcu::ping(uint8_t & ack)
+{
+    // Check in which mode MCU is. Bytes left in the input queue by
+    // previous sessions are stale, discard them before the ping.
+    CLogger::info("Sending zero byte");	
+    mSerialPort.flushInput();
+    ack = CMD_PING;
+    // Send zero byte
+    mSerialPort.write(&ack, 1, 1);
+    // Read response
+    return mSerialPort.readByte(&ack, READ_DEFAULT_TIMEOUT);
+}
+
+uint8_t
+CMcu::resync()
+{
+    CTimelineSpan span("resync", CATEGORY);
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    uint32_t junk = 0;
+    uint8_t ack = CMD_PING;
+    int i;
+
+    CLogger::info("Received unexpected data, resynchronizing with MCU");
+
+    for (i = 0; i < RESYNC_ATTEMPTS; ++i) {
+        if (i > 0)
+            CTimeline::mark("resync again", "retry");
+        // Wait until MCU stops sending, then ping it again
+        junk += mSerialPort.drainInput(RESYNC_IDLE_TIMEOUT);
+        ack = CMD_PING;
+        mSerialPort.write(&ack, 1, 1);
+        if (mSerialPort.readByte(&ack, RESYNC_PING_TIMEOUT)
+            && ((ack == BOOTSTRAP_ACK) || (ack == SHELL_ACK)))
+            break;
+    }
+
+    chrono::milliseconds d = chrono::duration_cast<chrono::milliseconds>(chrono::steady_clock::now() - start);
+    ostringstream os;
+    if (i < RESYNC_ATTEMPTS) {
+        os << "Resynchronized in " << d.count() << " ms (" << junk << " junk bytes drained, ";
+        os << (i + 1) << " pings)";
+        CLogger::info(os.str());
     } else {
-        CLogger::error("Received unknown ack byte " + CLogger::decToHex(ack) +
-                       ", expected " + CLogger::decToHex(BOOTSTRAP_ACK) +
-                       " or " + CLogger::decToHex(SHELL_ACK), EXIT_MCU);
+        os << "Cannot resynchronize with MCU in " << d.count() << " ms, no ack after ";
+        os << RESYNC_ATTEMPTS << " pings (" << junk << " junk bytes drained)";
+        CLogger::error(os.str(), EXIT_MCU);
     }
+
+    return ack;
 }
 
 void
@@ -153,6 +298,51 @@ CMcu::setMcuSpecificsById(uint16_t idmanuf, uint16_t idchip)
     }
 }
 
+string
+CMcu::sampleLineErrors()
+{
+    serial_line_errors_t c;
+
+    if (!mSerialPort.getLineErrors(c))
+        return "";
+
+    serial_line_errors_t d;
+    d.overrun = c.overrun - mLineErrors.overrun;
+    d.frame = c.frame - mLineErrors.frame;
+    d.parity = c.parity - mLineErrors.parity;
+    d.brk = c.brk - mLineErrors.brk;
+    d.bufOverrun = c.bufOverrun - mLineErrors.bufOverrun;
+    mLineErrors = c;
+
+    if (d.overrun)
+        CTimeline::mark("overrun", "uart", d.overrun);
+    if (d.frame)
+        CTimeline::mark("framing error", "uart", d.frame);
+    if (d.parity)
+        CTimeline::mark("parity error", "uart", d.parity);
+    if (d.brk)
+        CTimeline::mark("break", "uart", d.brk);
+    if (d.bufOverrun)
+        CTimeline::mark("buffer overrun", "uart", d.bufOverrun);
+
+    return CSerialPort::describeLineErrors(d);
+}
+
+string
+CMcu::checkLineErrors(const char *where, int64_t address)
+{
+    // Errors of the host UART tell lost data from errors reported by MCU
+    string e = sampleLineErrors();
+    if (e.empty())
+        return "";
+
+    string w = where;
+    if (address >= 0)
+        w += " at " + CLogger::decToHex(address);
+    CLogger::warning("Host serial port reports " + e + " in " + w);
+    return " (host serial port reports " + e + ")";
+}
+
 // -----------------------------------------------------------------------------
 //  Operacie
 // -----------------------------------------------------------------------------
@@ -165,7 +355,16 @@ CMcu::sendShellCommand(uint8_t cmd)
         CLogger::info("Ignoring -f option for this MCU");
     if ((mMcuSpecifics->getName() == "ST10F168") && (mMcuFrequency == 0))
         CLogger::error("Missing -f option for MCU " + mMcuSpecifics->getName(), EXIT_MCU);
-    
+
+    // Operations failing after an aborted read end without waiting for
+    // the rest of it, the next connection resynchronizes
+    if (mResyncPending) {
+        mResyncPending = false;
+        if (resync() != SHELL_ACK)
+            CLogger::error("MCU is not in the shell after aborted read", EXIT_MCU);
+    }
+
+    CTimelineSpan span("shell command", CATEGORY);
     mSerialPort.sendSafeByte(cmd);
     // Write configuration data
     list<uint16_t> d = mMcuSpecifics->getConfigData(mMcuFrequency);
@@ -174,21 +373,73 @@ CMcu::sendShellCommand(uint8_t cmd)
         mSerialPort.sendSafeWord(*it);
 }
 
+void
+CMcu::blankCheck(CBlankCheck & check, bool printProgress)
+{
+    if (check.getReadLength() > 0)
+        read(check.getReadLength(), check, printProgress);
+}
+
+bool
+CMcu::isBlank(unsigned int block)
+{
+    CBlockLayout layout(getBlockSizes());
+    list<unsigned int> l(1, block);
+    CBlankCheck check(layout, l);
+    blankCheck(check, false);
+    return check.isBlank(block);
+}
+
+double
+CMcu::getReadSeconds(uint32_t size, const string & speed, bool pipelined)
+{
+    advanceTo(PHASE_IDENTIFIED);
+    return CWriteEstimate::getReadSeconds(*mMcuSpecifics, size, speed, mMcuFrequency, pipelined);
+}
+
 string
 CMcu::ident()
 {
+    // Only identification leaves bootstrapped MCU in the stage 1 loader
+    advanceTo(PHASE_IDENTIFIED);
     return mMcuSpecifics->getName();
 }
 
+const list<uint32_t>
+CMcu::getBlockSizes()
+{
+    advanceTo(PHASE_IDENTIFIED);
+    return mMcuSpecifics->getBlockSizes();
+}
+
+uint32_t
+CMcu::getFlashSize()
+{
+    advanceTo(PHASE_IDENTIFIED);
+    return mMcuSpecifics->getFlashSize();
+}
+
+int
+CMcu::getBlockEraseTime()
+{
+    advanceTo(PHASE_IDENTIFIED);
+    return mMcuSpecifics->getBlockEraseTime();
+}
+
 void
 CMcu::erase()
 {
     uint16_t r;
     
+    advanceTo(PHASE_SHELL_LOADED);
+    CTimelineSpan span("erase chip", CATEGORY);
     sendShellCommand(CMD_ERASE_CHIP);
     // Wait for return status of erase operation
     mSerialPort.setReadTimeout(mMcuSpecifics->getEraseTimeout());
-    r = mSerialPort.readWord();
+    {
+        CTimelineSpan wait("erase wait", CATEGORY);
+        r = mSerialPort.readWord();
+    }
     mSerialPort.setDefaultTimeout();
 
     if (r != 0)
@@ -198,29 +449,7 @@ CMcu::erase()
 void
 CMcu::erase(uint32_t startAddr, uint32_t endAddr)
 {
-    list<uint32_t> bs = mMcuSpecifics->getBlockSizes();
-
-    // Block address space
-    typedef struct {
-        uint32_t a;
-        uint32_t b;
-    } range_t;
-    
-    unique_ptr<range_t []> ba(new(nothrow) range_t[bs.size()]);
-
-    if (!ba)
-        CLogger::error("Cannot allocate memory", EXIT_MCU);
-
-    list<uint32_t>::const_iterator it;
-    unsigned int i;
-    uint32_t a = 0;
-    for (i = 0, it = bs.begin(); it != bs.end(); ++it, ++i) {
-        ba[i].a = a;
-        a = (*it * 1024);
-        ba[i].b = ba[i].a + a - 1;
-        a = ba[i].a + a;
-    }
-
+    advanceTo(PHASE_SHELL_LOADED);
     uint32_t lastValidAddr = mMcuSpecifics->getFlashSize() - 1;
 
     if (startAddr > lastValidAddr) {
@@ -241,19 +470,12 @@ CMcu::erase(uint32_t startAddr, uint32_t endAddr)
         CLogger::error(os.str(), EXIT_MCU);
     }
 
-    // Construct block list
+    // Construct list of blocks covering the range
+    CBlockLayout layout(mMcuSpecifics->getBlockSizes());
     list<unsigned int> l;
-    // Find block containing startAddr
-    for (i = 0; i < bs.size(); ++i) {
-        if (startAddr >= ba[i].a && startAddr <= ba[i].b)
-            break;
-    }
-    // Find blocks up to the block containing endAddr
-    for ( ; i < bs.size(); ++i) {
+    unsigned int last = layout.findBlock(endAddr);
+    for (unsigned int i = layout.findBlock(startAddr); (i <= last) && (i < layout.getBlockCount()); ++i)
         l.push_back(i);
-        if (endAddr >= ba[i].a && endAddr <= ba[i].b)
-            break;
-    }
 
     // Erase blocks covering the range
     erase(l);
@@ -262,19 +484,10 @@ CMcu::erase(uint32_t startAddr, uint32_t endAddr)
 void
 CMcu::erase(list<unsigned int> blockList)
 {
-    // Construct mask
-    uint16_t mask = 0;
+    advanceTo(PHASE_SHELL_LOADED);
+    uint16_t mask = getEraseMask(blockList, mMcuSpecifics->getBlockSizes().size());
     list<unsigned int>::const_iterator it;
-    unsigned int bc = mMcuSpecifics->getBlockSizes().size();
 
-    for (it = blockList.begin(); it != blockList.end(); ++it) {
-        if (*it >= bc) {
-            ostringstream os;
-            os << "Block number " << *it << " is out of range [0," << (bc - 1) << "]";
-            CLogger::error(os.str(), EXIT_MCU);
-        }
-        mask |= 1 << *it;
-    }
     ostringstream os;
     os << "Erasing blocks: ";
     for (it = blockList.begin(); it != blockList.end(); ++it) {
@@ -286,11 +499,16 @@ CMcu::erase(list<unsigned int> blockList)
     CLogger::info(os.str());
     
     // Erase blocks
+    CTimelineSpan span("erase blocks", CATEGORY);
     sendShellCommand(CMD_ERASE_BLOCKS);
     mSerialPort.sendSafeWord(mask);
     // Read status
     mSerialPort.setReadTimeout(mMcuSpecifics->getEraseTimeout());
-    uint16_t r = mSerialPort.readWord();
+    uint16_t r;
+    {
+        CTimelineSpan wait("erase wait", CATEGORY);
+        r = mSerialPort.readWord();
+    }
 
     if (r != 0x00)
     	CLogger::error(getMessageForRetCode(r), EXIT_MCU);
@@ -299,21 +517,31 @@ CMcu::erase(list<unsigned int> blockList)
 }
 
 void
-CMcu::write(vector<uint8_t> data, bool printProgress)
+CMcu::write(const uint8_t *data, uint32_t size, bool printProgress)
+{
+    CMemorySource source(data, size);
+
+    write(source, size, printProgress);
+}
+
+void
+CMcu::write(CDataSource & source, uint32_t size, bool printProgress)
 {
-    if ((data.size() < 1) || (data.size() > mMcuSpecifics->getFlashSize())) {
+    advanceTo(PHASE_SHELL_LOADED);
+    if ((size < 1) || (size > mMcuSpecifics->getFlashSize())) {
         ostringstream os;
-        os << "Data length " << data.size() << " to write is not in range ";
+        os << "Data length " << size << " to write is not in range ";
         os << "[1-" << mMcuSpecifics->getFlashSize() << "]";
         CLogger::error(os.str(), EXIT_MCU);
     }
     // Number of bytes to be written
-    uint32_t bw = ((data.size() % 2) == 1) ? data.size() + 1 : data.size();
+    uint32_t bw = ((size % 2) == 1) ? size + 1 : size;
     ostringstream os;
-    os << "Writing " << data.size() << " bytes";
-    if (bw != data.size())
+    os << "Writing " << size << " bytes";
+    if (bw != size)
         os << " + 1 byte pad";
     CLogger::info(os.str());
+    CTimelineSpan span("write memory", CATEGORY, bw);
     // Write command
     sendShellCommand(CMD_WRITE);
     // Write number of bytes to read
@@ -322,36 +550,42 @@ CMcu::write(vector<uint8_t> data, bool printProgress)
     uint32_t i = 0;
 
     if (printProgress)
-        CLogger::progress(i, data.size());
+        CLogger::progress(i, size);
 
     while (i < bw) {
-        uint32_t s = ((bw - i) > 1024) ? 1024 : (bw - i);        
-        if (((i + s) >= bw) && (bw != data.size())) {
+        uint32_t s = ((bw - i) > 1024) ? 1024 : (bw - i);
+        CTimelineSpan block("block", CATEGORY, s);
+        if (((i + s) >= bw) && (bw != size)) {
             // Going to write last block of size increased by pad
-            mSerialPort.write(data.data() + i, s - 1, s - 1);
+            mSerialPort.write(source.next(s - 1), s - 1, s - 1);
             uint8_t b = PAD_BYTE;
             mSerialPort.write(&b, 1, 1);
         } else {
-            mSerialPort.write(data.data() + i, s, s);
+            mSerialPort.write(source.next(s), s, s);
         }
         i += s;
 
         if (printProgress)
-            CLogger::progress(i, data.size());
+            CLogger::progress(i, size);
 
         // Read status
+        CTimelineSpan status("block status", CATEGORY);
         uint16_t r = mSerialPort.readWord();
+        uint32_t u = 0;
         if (r == 0) {
             // Read position
-            uint32_t u = mSerialPort.readDoubleWord();
+            u = mSerialPort.readDoubleWord();
+        }
+        string e = checkLineErrors("block", i - s);
+        if (r == 0) {
             // Check position
             if ((bw - u) != i) {
                 ostringstream os;
                 os << "Serial communication error: position status mismatch, expected " << i << ", have " << (bw - u);
-                CLogger::error(os.str(), EXIT_MCU);
+                CLogger::error(os.str() + e, EXIT_MCU);
             }
         } else {
-            CLogger::error(getMessageForRetCode(r), EXIT_MCU);
+            CLogger::error(getMessageForRetCode(r) + e, EXIT_MCU);
         }
     }
 }
@@ -359,14 +593,26 @@ CMcu::write(vector<uint8_t> data, bool printProgress)
 vector<uint8_t>
 CMcu::read(bool printProgress)
 {
+    advanceTo(PHASE_SHELL_LOADED);
     return read(mMcuSpecifics->getFlashSize(), printProgress);
 }
 
 vector<uint8_t>
 CMcu::read(uint32_t size, bool printProgress)
+{
+    vector<uint8_t> data;
+    CBufferSink sink(data);
+
+    read(size, sink, printProgress);
+    return data;
+}
+
+void
+CMcu::read(uint32_t size, CDataSink & sink, bool printProgress)
 {
     uint32_t r;
 
+    advanceTo(PHASE_SHELL_LOADED);
     if ((size < 1) || (size > mMcuSpecifics->getFlashSize())) {
         ostringstream os;
         os << "Data length " << size << " to read is outside address range ";
@@ -378,6 +624,7 @@ CMcu::read(uint32_t size, bool printProgress)
     r = size;
     if ((size % 2) == 1)
         r++;
+    CTimelineSpan span("read memory", CATEGORY, r);
     // Write command
     sendShellCommand(CMD_READ);
     // Write number of bytes to read
@@ -387,36 +634,54 @@ CMcu::read(uint32_t size, bool printProgress)
     if (printProgress)
         CLogger::progress(i, size);
 
-    vector<uint8_t> data;
+    uint8_t block[1024];
+    sink.begin(size);
 
     while (i < r) {
         uint32_t s = ((r - i) > 1024) ? 1024 : (r - i);
+        CTimelineSpan blockSpan("block", CATEGORY, s);
         // Read data
-        data.resize(data.size() + s);
-        mSerialPort.read(data.data() + i , s);
+        mSerialPort.read(block, s);
         i += s;
 
+        // Read status
+        {
+            CTimelineSpan status("block status", CATEGORY);
+            uint16_t t = mSerialPort.readWord();
+            uint32_t u = 0;
+            if (t == 0) {
+                // Read position
+                u = mSerialPort.readDoubleWord();
+            }
+            string e = checkLineErrors("block", i - s);
+            if (t == 0) {
+                // Check position
+                if ((r - u) != i) {
+                    ostringstream os;
+                    os << "Serial communication error: position status mismatch";
+                    os << ", expected " << i << " has " << (r - u);
+                    CLogger::error(os.str() + e, EXIT_MCU);
+                }
+            } else {
+                CLogger::error(getMessageForRetCode(t) + e, EXIT_MCU);
+            }
+        }
+
+        // Pass block without possible rounding/pad byte
+        sink.write(block, (i > size) ? s - (i - size) : s);
+
         if (printProgress)
             CLogger::progress(i, size);
 
-        // Read status
-        uint16_t t = mSerialPort.readWord();
-        if (t == 0) {
-            // Read position
-            uint32_t u = mSerialPort.readDoubleWord();
-            // Check position
-            if ((r - u) != i) {
-                ostringstream os;
-                os << "Serial communication error: position status mismatch";
-                os << ", expected " << i << " has " << (r - u);
-        	CLogger::error(os.str(), EXIT_MCU);                
-            }
-        } else {
-            CLogger::error(getMessageForRetCode(r), EXIT_MCU);
+        if (sink.isAborted() && (i < r)) {
+            // Shell sends the rest without waiting, it is skipped only when
+            // another command follows
+            mResyncPending = true;
+            ostringstream os;
+            os << "Reading aborted after " << i << " bytes";
+            CLogger::info(os.str());
+            return;
         }
     }
-
-    // Discard possible rounding/pad byte
-    data.resize(size);
-    return data;
+    sink.end();
 }
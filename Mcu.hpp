@@ -3,6 +3,10 @@
 
 #include "SerialPort.hpp"
 #include "McuSpecifics.hpp"
+#include "ResetSequence.hpp"
+#include "DataSink.hpp"
+#include "DataSource.hpp"
+#include "BlankCheck.hpp"
 
 #include <cstdint>
 #include <vector>
@@ -13,25 +17,73 @@ using std::unique_ptr;
 
 class CMcu {
 private:
+    // Session phases, MCU advances through them on demand
+    typedef enum {
+        PHASE_CONNECTED,    // Ack received, MCU model is not known yet
+        PHASE_IDENTIFIED,   // IDMANUF and IDCHIP registers read
+        PHASE_SHELL_LOADED  // Stage 2 firmware accepts commands
+    } phase_t;
+
     CSerialPort & mSerialPort;
     unique_ptr<IMcuSpecifics> mMcuSpecifics;
     float mMcuFrequency;
+    phase_t mPhase;
+    bool mBootstrap;
+    // Shell may still send data of an aborted read
+    bool mResyncPending;
+    // Receive errors of the host UART at the last sample
+    serial_line_errors_t mLineErrors;
+
+    void advanceTo(phase_t phase);
+    void identify();
+    void loadShell();
 
+    bool ping(uint8_t & ack);
+    uint8_t resync();
     void decodeIdentData(uint8_t data[4], uint16_t & idmanuf, uint16_t & idchip);
     void setMcuSpecificsById(uint16_t idmanuf, uint16_t idchip);
     string getMessageForRetCode(uint16_t ret);
     void sendShellCommand(uint8_t cmd);
+    string sampleLineErrors();
+    // Address is of the block just transferred, -1 when not a block
+    string checkLineErrors(const char *where, int64_t address = -1);
 
 public:
-    CMcu(CSerialPort & serialPort, float mcuFrequency);
+    CMcu(CSerialPort & serialPort, float mcuFrequency, const CResetSequence * resetSequence = 0);
+
+    // Specifics of MCU by its name as printed by ident, case is ignored.
+    // Returns null for an unknown name.
+    static unique_ptr<IMcuSpecifics> getMcuSpecificsByName(const string & name);
+    // Mask of the erase command, fails when a block is out of range
+    static uint16_t getEraseMask(const list<unsigned int> & blockList, unsigned int blockCount);
+    // Bytes sent to MCU in bootstrap mode until the shell runs, padding
+    // of the loaded firmware included
+    static void getLoaderLength(IMcuSpecifics & specifics, uint32_t & length, uint32_t & padding);
+
+    void init();
 
     void erase();
     void erase(list<unsigned int> blockList);
     void erase(uint32_t startAddr, uint32_t endAddr);
-    void write(vector<uint8_t> data, bool printProgress);
+    // Data are sent directly from the caller's buffer
+    void write(const uint8_t *data, uint32_t size, bool printProgress);
+    // Blocks are requested from source as the transfer proceeds
+    void write(CDataSource & source, uint32_t size, bool printProgress);
     vector<uint8_t> read(bool printProgress);
     vector<uint8_t> read(uint32_t size, bool printProgress);
+    // Pass memory content to sink block by block as it is received. Rest
+    // of a read aborted by the sink is skipped by the next command only.
+    void read(uint32_t size, CDataSink & sink, bool printProgress);
+    // Shell has no blank check command, memory is read from address 0 up
+    // to the last checked block
+    void blankCheck(CBlankCheck & check, bool printProgress);
+    bool isBlank(unsigned int block);
+    // Estimated time of reading size bytes from address 0 at serial speed
+    double getReadSeconds(uint32_t size, const string & speed, bool pipelined);
     string ident();
+    const list<uint32_t> getBlockSizes();
+    uint32_t getFlashSize();
+    int getBlockEraseTime();
 };
 
 #endif
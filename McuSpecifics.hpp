@@ -19,6 +19,8 @@ public:
     virtual const list<uint32_t> getBlockSizes() = 0;
     virtual uint32_t getFlashSize() = 0;
     virtual int getEraseTimeout() = 0;
+    // Typical time in ms to erase one block, used for estimates only
+    virtual int getBlockEraseTime() = 0;
     virtual string getMessageForRetCode(uint16_t ret) = 0; 
     virtual const list<uint16_t> getConfigData(float mcuFrequency) = 0; 
 };
@@ -12,6 +12,7 @@ using FwSt10f168::fw_st10f168_length;
 #define ST10F168_IDMANUF 0x0400
 #define ST10F168_IDCHIP 0x0A80
 #define ST10F168_ERASE_TIMEOUT 15000 // Ms
+#define ST10F168_BLOCK_ERASE_TIME 1500 // Ms, typical
 #define ST10F168_MIN_PERIOD 30  // ns
 #define ST10F168_MAX_PERIOD 199 // ns
 #define ST10F168_MAX_FREQ   25  // MHz
@@ -75,6 +76,12 @@ CMcuSt10f168::getEraseTimeout()
     return ST10F168_ERASE_TIMEOUT; 
 }
 
+int
+CMcuSt10f168::getBlockEraseTime()
+{
+    return ST10F168_BLOCK_ERASE_TIME;
+}
+
 string
 CMcuSt10f168::getMessageForRetCode(uint16_t ret)
 {
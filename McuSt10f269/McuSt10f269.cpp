@@ -9,6 +9,7 @@ using FwSt10f269::fw_st10f269_length;
 #define ST10F269_IDMANUF 0x0401
 #define ST10F269_IDCHIP 0x10D0
 #define ST10F269_ERASE_TIMEOUT 15000 // Ms
+#define ST10F269_BLOCK_ERASE_TIME 1500 // Ms, typical
 
 #define RET_ERASE_ERROR 0x030
 #define RET_WRITE_ERROR 0x031
@@ -73,6 +74,12 @@ CMcuSt10f269::getEraseTimeout()
     return ST10F269_ERASE_TIMEOUT; 
 }
 
+int
+CMcuSt10f269::getBlockEraseTime()
+{
+    return ST10F269_BLOCK_ERASE_TIME;
+}
+
 string
 CMcuSt10f269::getMessageForRetCode(uint16_t ret)
 {
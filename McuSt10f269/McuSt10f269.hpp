@@ -18,6 +18,7 @@ public:
     const list<uint32_t> getBlockSizes();
     uint32_t getFlashSize();
     int getEraseTimeout();
+    int getBlockEraseTime();
     string getMessageForRetCode(uint16_t ret);
     const list<uint16_t> getConfigData(float mcuFrequency);
 };
@@ -0,0 +1,146 @@
+#include "Patch.hpp"
+#include "ExitCodes.hpp"
+#include "Logger.hpp"
+
+#include <stdio.h>
+
+#include <sstream>
+#include <iomanip>
+
+using std::istringstream;
+using std::noskipws;
+
+#define PATCH_MAX_LENGTH         4096
+#define PATCH_DEFAULT_WIDTH      4
+
+CPatch::CPatch(const string & specification)
+    : mSpecification(specification), mAddress(0), mCounter(false),
+      mCounterStart(0), mCounterWidth(PATCH_DEFAULT_WIDTH)
+{
+    string::size_type eq = specification.find('=');
+
+    if ((eq == string::npos) || (eq == 0) || (eq + 1 == specification.length()))
+        specificationError("expected ADDR=HEX, ADDR=@FILE or ADDR={START[:WIDTH]}");
+
+    string a = specification.substr(0, eq);
+    istringstream is(a);
+    unsigned long address;
+    is >> std::setbase(0) >> noskipws >> address;
+    if (is.fail() || (is.peek() != EOF) || (a[0] == '-') || (a[0] == '+') || (address > 0xFFFFFFFFul))
+        specificationError("bad address '" + a + "'");
+    mAddress = address;
+
+    string v = specification.substr(eq + 1);
+    if (v[0] == '@')
+        parseFile(v.substr(1));
+    else if (v[0] == '{')
+        parseCounter(v);
+    else
+        parseHex(v);
+
+    if ((uint64_t) mAddress + getLength() > 0x100000000ull)
+        specificationError("data exceed 32-bit address space");
+}
+
+void
+CPatch::specificationError(const string & msg) const
+{
+    CLogger::error("Bad patch '" + mSpecification + "': " + msg, EXIT_USER_CONFIG);
+}
+
+void
+CPatch::parseHex(const string & v)
+{
+    string::size_type i = 0;
+
+    // Optional 0x prefix
+    if ((v.length() > 2) && (v[0] == '0') && ((v[1] == 'x') || (v[1] == 'X')))
+        i = 2;
+    if (((v.length() - i) % 2 != 0) || ((v.length() - i) / 2 > PATCH_MAX_LENGTH))
+        specificationError("expected even number of hexadecimal digits");
+
+    for ( ; i < v.length(); i += 2) {
+        istringstream is(v.substr(i, 2));
+        unsigned int b;
+        is >> std::hex >> noskipws >> b;
+        if (is.fail() || (is.peek() != EOF))
+            specificationError("bad hexadecimal digit");
+        mData.push_back(b);
+    }
+}
+
+void
+CPatch::parseFile(const string & v)
+{
+    FILE *f;
+
+    if ((f = fopen(v.c_str(), "rb")) == NULL)
+	CLogger::error("Cannot open file for reading: " + v, EXIT_MAIN_FILE_INOUT);
+
+    mData.resize(PATCH_MAX_LENGTH + 1);
+    size_t r = fread(mData.data(), 1, mData.size(), f);
+    bool failed = ferror(f);
+    fclose(f);
+    if (failed)
+        CLogger::error("Cannot read from file: " + v, EXIT_MAIN_FILE_INOUT);
+    mData.resize(r);
+
+    if (mData.empty() || (mData.size() > PATCH_MAX_LENGTH))
+        specificationError("file must have 1 to " + std::to_string(PATCH_MAX_LENGTH) + " bytes");
+}
+
+void
+CPatch::parseCounter(const string & v)
+{
+    if (v[v.length() - 1] != '}')
+        specificationError("counter must be in format {START[:WIDTH]}");
+
+    string c = v.substr(1, v.length() - 2);
+    string::size_type colon = c.find(':');
+    string start = c.substr(0, colon);
+
+    istringstream is(start);
+    is >> std::setbase(0) >> noskipws >> mCounterStart;
+    if (start.empty() || is.fail() || (is.peek() != EOF) || (start[0] == '-') || (start[0] == '+'))
+        specificationError("bad counter start '" + start + "'");
+
+    if (colon != string::npos) {
+        string width = c.substr(colon + 1);
+        istringstream iw(width);
+        iw >> noskipws >> mCounterWidth;
+        if (iw.fail() || (iw.peek() != EOF) || (mCounterWidth < 1) || (mCounterWidth > 8))
+            specificationError("counter width '" + width + "' is not 1 to 8 bytes");
+    }
+    if ((mCounterWidth < 8) && (mCounterStart >> (8 * mCounterWidth)))
+        specificationError("counter start does not fit in its width");
+
+    mCounter = true;
+}
+
+uint32_t
+CPatch::getAddress() const
+{
+    return mAddress;
+}
+
+uint32_t
+CPatch::getLength() const
+{
+    return mCounter ? mCounterWidth : mData.size();
+}
+
+vector<uint8_t>
+CPatch::getData(unsigned long unit) const
+{
+    if (!mCounter)
+        return mData;
+
+    uint64_t value = mCounterStart + unit;
+    if (((mCounterWidth < 8) && (value >> (8 * mCounterWidth))) || (value < mCounterStart))
+        specificationError("counter overflowed its width");
+
+    vector<uint8_t> data(mCounterWidth);
+    for (unsigned int i = 0; i < mCounterWidth; ++i)
+        data[i] = value >> (8 * i);
+    return data;
+}
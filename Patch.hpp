@@ -0,0 +1,41 @@
+#ifndef PATCH_HPP
+#define PATCH_HPP 1
+
+#include "Image.hpp"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using std::string;
+using std::vector;
+
+// Data written over the image at a fixed address, different for each
+// programmed unit when a counter is used. Specification is ADDR=VALUE where
+// VALUE is hexadecimal bytes, @FILE with raw content or {START[:WIDTH]}, a
+// counter of WIDTH bytes (4 by default) stored in little endian order which
+// starts at START and is incremented for every unit.
+class CPatch {
+private:
+    string mSpecification;
+    uint32_t mAddress;
+    vector<uint8_t> mData;
+    bool mCounter;
+    uint64_t mCounterStart;
+    unsigned int mCounterWidth;
+
+    void parseHex(const string & v);
+    void parseFile(const string & v);
+    void parseCounter(const string & v);
+    void specificationError(const string & msg) const;
+
+public:
+    CPatch(const string & specification);
+
+    uint32_t getAddress() const;
+    uint32_t getLength() const;
+    // Patch data for the unit with given sequence number from 0
+    vector<uint8_t> getData(unsigned long unit) const;
+};
+
+#endif
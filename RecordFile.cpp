@@ -0,0 +1,120 @@
+#include "RecordFile.hpp"
+#include "ExitCodes.hpp"
+#include "Logger.hpp"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <sstream>
+#include <vector>
+
+using std::ostringstream;
+using std::vector;
+
+#define RECORD_READ_CHUNK (64 * 1024)
+
+int
+CRecordFile::hexDigit(char c)
+{
+    if ((c >= '0') && (c <= '9'))
+        return c - '0';
+    if ((c >= 'A') && (c <= 'F'))
+        return c - 'A' + 10;
+    if ((c >= 'a') && (c <= 'f'))
+        return c - 'a' + 10;
+    return -1;
+}
+
+bool
+CRecordFile::hasExtension(const string & fpath, const char * const ext[])
+{
+    string::size_type d = fpath.rfind('.');
+
+    if (d == string::npos)
+        return false;
+    for (int i = 0; ext[i] != 0; ++i) {
+        if (!fpath.compare(d, string::npos, ext[i]))
+            return true;
+    }
+    return false;
+}
+
+CRecordFile::CRecordFile(const string & fpath)
+    : mPath(fpath), mLine(0)
+{
+    ;
+}
+
+void
+CRecordFile::recordError(const string & msg)
+{
+    ostringstream os;
+    os << mPath << ":" << mLine << ": " << msg;
+    CLogger::error(os.str(), EXIT_MAIN_FILE_INOUT);
+}
+
+void
+CRecordFile::decodeBytes(const char *s, size_t n, uint8_t *b)
+{
+    for (size_t i = 0; i < n; ++i) {
+        int h = hexDigit(s[2 * i]);
+        int l = hexDigit(s[2 * i + 1]);
+        if ((h < 0) || (l < 0))
+            recordError("Bad hexadecimal digit");
+        b[i] = (h << 4) | l;
+    }
+}
+
+void
+CRecordFile::read(CImage & image)
+{
+    FILE *f = stdin;
+    bool isStdin = !mPath.compare("-");
+
+    if (!isStdin && ((f = fopen(mPath.c_str(), "rb")) == NULL))
+	CLogger::error("Cannot open file for reading: " + mPath, EXIT_MAIN_FILE_INOUT);
+
+    // Lines are parsed directly in the read buffer, only the incomplete
+    // line at its end is moved to the beginning for the next chunk
+    vector<char> buf(RECORD_READ_CHUNK);
+    size_t kept = 0;
+
+    try {
+        for (;;) {
+            if (kept == buf.size())
+                buf.resize(buf.size() * 2);
+            size_t r = fread(buf.data() + kept, 1, buf.size() - kept, f);
+            if (ferror(f))
+                CLogger::error("Cannot read from file: " + mPath, EXIT_MAIN_FILE_INOUT);
+            size_t n = kept + r;
+            size_t start = 0;
+
+            for (size_t i = 0; i < n; ++i) {
+                if (buf[i] == '\n') {
+                    ++mLine;
+                    parseRecord(buf.data() + start, i - start, image);
+                    start = i + 1;
+                }
+            }
+            if (r == 0) {
+                // Last line without line feed
+                if (start < n) {
+                    ++mLine;
+                    parseRecord(buf.data() + start, n - start, image);
+                }
+                break;
+            }
+            kept = n - start;
+            memmove(buf.data(), buf.data() + start, kept);
+        }
+    } catch (...) {
+        // Errors of records are reported by exceptions
+        if (!isStdin)
+            fclose(f);
+        throw;
+    }
+    if (!isStdin)
+        fclose(f);
+
+    finish();
+}
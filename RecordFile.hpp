@@ -0,0 +1,36 @@
+#ifndef RECORD_FILE_HPP
+#define RECORD_FILE_HPP 1
+
+#include "Image.hpp"
+
+#include <iostream>
+
+using std::string;
+
+// Text file with one record per line (Intel HEX, Motorola S-record). File
+// is read in one pass, records are parsed directly into a sparse image.
+// File name "-" stands for standard input.
+class CRecordFile {
+protected:
+    string mPath;
+    unsigned long mLine;
+
+    static int hexDigit(char c);
+
+    void recordError(const string & msg);
+    // Decode n bytes written as hexadecimal digits
+    void decodeBytes(const char *s, size_t n, uint8_t *b);
+
+    virtual void parseRecord(const char *s, size_t length, CImage & image) = 0;
+    virtual void finish() = 0;
+
+public:
+    static bool hasExtension(const string & fpath, const char * const ext[]);
+
+    CRecordFile(const string & fpath);
+    virtual ~CRecordFile() { ; };
+
+    void read(CImage & image);
+};
+
+#endif
@@ -0,0 +1,87 @@
+#include "ResetSequence.hpp"
+#include "ExitCodes.hpp"
+#include "Logger.hpp"
+
+#include <sstream>
+#include <thread>
+#include <chrono>
+
+using std::istringstream;
+using std::noskipws;
+
+#define RESET_SEQUENCE_MAX_DELAY 10000 // ms
+
+CResetSequence::CResetSequence(const string & specification)
+    : mSpecification(specification)
+{
+    istringstream is(specification);
+    string s;
+
+    // Steps are separated by commas
+    while (getline(is, s, ','))
+        parseStep(s);
+
+    if (mSteps.empty() || (specification[specification.length() - 1] == ','))
+        CLogger::error("Argument for --reset-seq option must be in format STEP[,STEP]...",
+                       EXIT_USER_CONFIG);
+}
+
+void
+CResetSequence::parseStep(const string & s)
+{
+    step_t step;
+    string::size_type eq = s.find('=');
+
+    if (eq == string::npos) {
+        // Delay in milliseconds
+        istringstream is(s);
+        step.line = 0;
+        step.state = false;
+        is >> noskipws >> step.delayMs;
+        if (is.fail() || (is.peek() != EOF) || (step.delayMs < 0)
+            || (step.delayMs > RESET_SEQUENCE_MAX_DELAY)) {
+            CLogger::error("Bad delay '" + s + "' in reset sequence, expected number of ms up to "
+                           + std::to_string(RESET_SEQUENCE_MAX_DELAY), EXIT_USER_CONFIG);
+        }
+    } else {
+        // Line change
+        string l = s.substr(0, eq);
+        string v = s.substr(eq + 1);
+        if (!l.compare("dtr") || !l.compare("DTR"))
+            step.line = SERIAL_LINE_DTR;
+        else if (!l.compare("rts") || !l.compare("RTS"))
+            step.line = SERIAL_LINE_RTS;
+        else
+            CLogger::error("Unknown modem control line '" + l + "' in reset sequence", EXIT_USER_CONFIG);
+        if (!v.compare("1"))
+            step.state = true;
+        else if (!v.compare("0"))
+            step.state = false;
+        else
+            CLogger::error("Bad state '" + v + "' of line " + l + " in reset sequence, expected 0 or 1",
+                           EXIT_USER_CONFIG);
+        step.delayMs = 0;
+    }
+
+    mSteps.push_back(step);
+}
+
+const string &
+CResetSequence::getSpecification() const
+{
+    return mSpecification;
+}
+
+void
+CResetSequence::apply(CSerialPort & serialPort) const
+{
+    vector<step_t>::const_iterator it;
+
+    CLogger::info("Resetting MCU into bootstrap mode: " + mSpecification);
+    for (it = mSteps.begin(); it != mSteps.end(); ++it) {
+        if (it->line != 0)
+            serialPort.setModemLine(it->line, it->state);
+        else
+            std::this_thread::sleep_for(std::chrono::milliseconds(it->delayMs));
+    }
+}
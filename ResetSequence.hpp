@@ -0,0 +1,32 @@
+#ifndef RESET_SEQUENCE_HPP
+#define RESET_SEQUENCE_HPP 1
+
+#include "SerialPort.hpp"
+
+#include <vector>
+
+using std::vector;
+
+// Sequence of modem control line changes and delays which puts MCU into
+// bootstrap mode, e.g. "dtr=1,rts=1,50,rts=0,100" when RTS drives RESET
+// and DTR drives P0L.4.
+class CResetSequence {
+private:
+    typedef struct {
+        int line;     // SERIAL_LINE_* or 0 for a delay
+        bool state;
+        int delayMs;
+    } step_t;
+
+    string mSpecification;
+    vector<step_t> mSteps;
+
+    void parseStep(const string & s);
+public:
+    CResetSequence(const string & specification);
+
+    const string & getSpecification() const;
+    void apply(CSerialPort & serialPort) const;
+};
+
+#endif
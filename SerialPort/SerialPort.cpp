@@ -2,38 +2,31 @@
 #include "Logger.hpp"
 #include "ExitException.hpp"
 #include "ExitCodes.hpp"
+#include "Timeline.hpp"
 #include <cstring>
 #include <sstream>
 
 using std::ostringstream;
 
-#define READ_DEFAULT_TIMEOUT 3000 // ms
-
 void
 CSerialPort::writeWord(uint16_t w)
 {
-    uint8_t b;
-    
-    b = (w & 0xff);
-    this->write(&b, 1, 1);
+    uint8_t b[2];
     
-    b = (w & 0xff00) >> 8;
-    this->write(&b, 1, 1);
+    b[0] = (w & 0xff);
+    b[1] = (w & 0xff00) >> 8;
+    this->write(b, 2, 2);
 }
 
 uint16_t
 CSerialPort::readWord()
 {
-    uint8_t b;
+    uint8_t b[2];
     uint16_t w;
     
-    w = 0;
-    
-    this->read(&b, 1);
-    w |= ((uint16_t) b);
-
-    this->read(&b, 1);
-    w |= ((uint16_t) b) << 8;
+    this->read(b, 2);
+    w = ((uint16_t) b[0]);
+    w |= ((uint16_t) b[1]) << 8;
 
     return w;
 }
@@ -41,22 +34,14 @@ CSerialPort::readWord()
 uint32_t
 CSerialPort::readDoubleWord()
 {
-    uint8_t b;
+    uint8_t b[4];
     uint32_t dw;
 
-    dw = 0;
-    
-    this->read(&b, 1);
-    dw |= ((uint32_t) b);
-
-    this->read(&b, 1);
-    dw |= ((uint32_t) b) << 8;
-
-    this->read(&b, 1);
-    dw |= ((uint32_t) b) << 16;
-    
-    this->read(&b, 1);
-    dw |= ((uint32_t) b) << 24;
+    this->read(b, 4);
+    dw = ((uint32_t) b[0]);
+    dw |= ((uint32_t) b[1]) << 8;
+    dw |= ((uint32_t) b[2]) << 16;
+    dw |= ((uint32_t) b[3]) << 24;
 
     return dw;
 }
@@ -74,16 +59,24 @@ CSerialPort::setDefaultTimeout()
 }
 
 void
-CSerialPort::write(uint8_t *data, int data_length, int padd_to)
+CSerialPort::setPipelinedHandshakes(bool b)
+{
+    mPipelinedHandshakes = b;
+}
+
+void
+CSerialPort::write(const uint8_t *data, int data_length, int padd_to)
 {    
     // Write data
     for (int i = 0; i < data_length; )
-        i += writeSingle(data, data_length);
+        i += writeSingle(data + i, data_length - i);
     // Write pad
     // TODO: odkial brat hodnotu pad byte??
     uint8_t p[512];
     memset(p, 0xFF, 512);
 
+    if (padd_to > data_length)
+        CTimeline::mark("padding", "serial", padd_to - data_length);
     for (padd_to -= data_length; padd_to > 0; ) {
         int w = 512;
         if (padd_to < 512)
@@ -108,21 +101,30 @@ CSerialPort::read(uint8_t *data, int data_length)
 void
 CSerialPort::sendSafeByte(uint8_t b)
 {
-    uint8_t r;
-
-    this->write(&b, 1, 1);
-    this->read(&r, 1);
-    if (r != b) {
+    uint8_t r[2];
+
+    if (mPipelinedHandshakes) {
+        // MCU compares the second copy with the first one by itself
+        uint8_t d[2] = { b, b };
+        this->write(d, 2, 2);
+        this->read(r, 2);
+    } else {
+        this->write(&b, 1, 1);
+        this->read(&r[0], 1);
+    }
+    if (r[0] != b) {
         ostringstream os;
         os << "Bad echo when sending byte safely, expected " << CLogger::decToHex(b);
-        os << " received " << CLogger::decToHex(r);
+        os << " received " << CLogger::decToHex(r[0]);
         CLogger::error(os.str(), EXIT_SERIAL_PORT);
     }
-    this->write(&b, 1, 1);
-    this->read(&r, 1);
-    if (r != 0x00) {
+    if (!mPipelinedHandshakes) {
+        this->write(&b, 1, 1);
+        this->read(&r[1], 1);
+    }
+    if (r[1] != 0x00) {
         ostringstream os;
-        os << "Cannot send byte safely, expected 0x00 received " << CLogger::decToHex(r);  
+        os << "Cannot send byte safely, expected 0x00 received " << CLogger::decToHex(r[1]);  
         CLogger::error(os.str(), EXIT_SERIAL_PORT);    
     }
 }
@@ -130,19 +132,32 @@ CSerialPort::sendSafeByte(uint8_t b)
 void
 CSerialPort::sendSafeWord(uint16_t w)
 {
-    this->writeWord(w);
-    uint16_t r = this->readWord();
+    uint16_t r;
+    uint16_t s = 0;
+
+    if (mPipelinedHandshakes) {
+        uint8_t d[4] = { (uint8_t) (w & 0xff), (uint8_t) ((w & 0xff00) >> 8),
+                         (uint8_t) (w & 0xff), (uint8_t) ((w & 0xff00) >> 8) };
+        this->write(d, 4, 4);
+        r = this->readWord();
+        s = this->readWord();
+    } else {
+        this->writeWord(w);
+        r = this->readWord();
+    }
     if (r != w) {
         ostringstream os;
         os << "Bad echo when sending word safely, expected " << CLogger::decToHex(w);
         os << " received " << CLogger::decToHex(r);
         CLogger::error(os.str(), EXIT_SERIAL_PORT);
     }
-    this->writeWord(w);
-    r = this->readWord();
-    if (r != 0x00) {
+    if (!mPipelinedHandshakes) {
+        this->writeWord(w);
+        s = this->readWord();
+    }
+    if (s != 0x00) {
         ostringstream os;
-        os << "Cannot send word safely, expected 0x0000 received " << CLogger::decToHex(r);  
+        os << "Cannot send word safely, expected 0x0000 received " << CLogger::decToHex(s);  
         CLogger::error(os.str(), EXIT_SERIAL_PORT);    
     }
 }
@@ -155,3 +170,51 @@ CSerialPort::sendSafeDoubleWord(uint32_t w)
     // Send high word
     sendSafeWord((w & 0xFFFF0000) >> 16);
 }
+
+bool
+CSerialPort::readByte(uint8_t *b, int timeoutMs)
+{
+    return (readAvailable(b, 1, timeoutMs) == 1);
+}
+
+string
+CSerialPort::describeLineErrors(const serial_line_errors_t & errors)
+{
+    const struct {
+        uint32_t count;
+        const char *name;
+    } e[] = {
+        { errors.overrun, "overrun" },
+        { errors.frame, "framing error" },
+        { errors.parity, "parity error" },
+        { errors.brk, "break" },
+        { errors.bufOverrun, "buffer overrun" }
+    };
+    ostringstream os;
+
+    for (const auto & i : e) {
+        if (i.count == 0)
+            continue;
+        if (os.tellp() > 0)
+            os << ", ";
+        os << i.count << " " << i.name << ((i.count > 1) ? "s" : "");
+    }
+
+    return os.str();
+}
+
+uint32_t
+CSerialPort::drainInput(int idleTimeoutMs)
+{
+    uint8_t b[512];
+    uint32_t n = 0;
+    ssize_t r;
+
+    // Throw away what is already queued, then read in bulk until the line
+    // stays idle for idleTimeoutMs
+    flushInput();
+    while ((r = readAvailable(b, sizeof(b), idleTimeoutMs)) > 0)
+        n += r;
+
+    return n;
+}
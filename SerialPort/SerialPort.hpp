@@ -6,31 +6,67 @@
 
 using std::string;
 
+#define READ_DEFAULT_TIMEOUT 3000 // ms
+
+// Modem control lines
+#define SERIAL_LINE_DTR 0x01
+#define SERIAL_LINE_RTS 0x02
+
+// Receive errors counted by the host UART driver
+typedef struct {
+    uint32_t overrun;     // UART receiver overrun
+    uint32_t frame;
+    uint32_t parity;
+    uint32_t brk;
+    uint32_t bufOverrun;  // Driver buffer overrun
+} serial_line_errors_t;
+
 class CSerialPort {
+    // Decorators pass calls of the decorated port through
+    friend class CSerialPortRecorder;
+    friend class CSerialPortTimeline;
 protected:
     int mReadTimeoutMs; // Miliseconds
+    // Send both copies of a safely sent value without waiting for echo
+    bool mPipelinedHandshakes;
 
     virtual ssize_t readSingle(uint8_t *data, int data_length) = 0;
-    virtual ssize_t writeSingle(uint8_t *data, int data_length) = 0;
+    virtual ssize_t writeSingle(const uint8_t *data, int data_length) = 0;
+    // Read at most data_length bytes arriving within timeoutMs, returns 0
+    // on timeout instead of failing
+    virtual ssize_t readAvailable(uint8_t *data, int data_length, int timeoutMs) = 0;
 public:
+    CSerialPort() : mReadTimeoutMs(READ_DEFAULT_TIMEOUT), mPipelinedHandshakes(false) { ; };
     virtual ~CSerialPort() { ; };
     
     virtual void open(string portName, string speed) = 0;
     virtual string getSpeeds(string portName) = 0;
 
     virtual void close() = 0;
+    // Discard data received but not yet read
+    virtual void flushInput() = 0;
+    // Set modem control line SERIAL_LINE_* to given state
+    virtual void setModemLine(int line, bool state) = 0;
+    // Receive errors since the port was opened, false when the driver
+    // does not count them
+    virtual bool getLineErrors(serial_line_errors_t & errors) { return false; };
+    // Counts of nonzero errors, e.g. "2 overruns, 1 framing error"
+    static string describeLineErrors(const serial_line_errors_t & errors);
 
     void setReadTimeout(int ms);
     void setDefaultTimeout();
+    void setPipelinedHandshakes(bool b);
 
     void writeWord(uint16_t w);
     uint16_t readWord();
     uint32_t readDoubleWord();
     void read(uint8_t *data, int data_length);
-    void write(uint8_t *data, int data_length, int padd);
+    void write(const uint8_t *data, int data_length, int padd);
     void sendSafeByte(uint8_t b);
     void sendSafeWord(uint16_t w);
     void sendSafeDoubleWord(uint32_t w);
+    bool readByte(uint8_t *b, int timeoutMs);
+    uint32_t drainInput(int idleTimeoutMs);
 
 };
 
@@ -1,20 +1,40 @@
 #include "SerialPortFactory.hpp"
+#include "ExitCodes.hpp"
+#include "Logger.hpp"
+#include "SerialPortTrace.hpp"
 
 #ifdef WIN32
 #include "SerialPortWin32.hpp"
 #else
 #include "SerialPortUnix.hpp"
+#include "SerialPortTcp.hpp"
 #endif
 
+void
+CSerialPortFactory::setReplayTimed(bool b)
+{
+    mReplayTimed = b;
+}
+
 std::unique_ptr<CSerialPort>
-CSerialPortFactory::getSerialPort()
+CSerialPortFactory::getSerialPort(const string & portName)
 {
     std::unique_ptr<CSerialPort> sp;
 
+    if (CSerialPortReplay::isReplayPortName(portName)) {
+        sp.reset(new CSerialPortReplay(mReplayTimed));
+        return sp;
+    }
+
 #ifdef WIN32
+    if (!portName.compare(0, 6, "tcp://") || !portName.compare(0, 10, "rfc2217://"))
+        CLogger::error("Network serial ports are not supported on this platform", EXIT_SERIAL_PORT);
     sp.reset(new CSerialPortWin32());
 #else
-    sp.reset(new CSerialPortUnix());
+    if (CSerialPortTcp::isTcpPortName(portName))
+        sp.reset(new CSerialPortTcp());
+    else
+        sp.reset(new CSerialPortUnix());
 #endif
 
     return sp; 
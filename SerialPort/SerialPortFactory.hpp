@@ -6,8 +6,14 @@
 #include "SerialPort.hpp"
 
 class CSerialPortFactory {
+private:
+    bool mReplayTimed;
 public:
-    std::unique_ptr<CSerialPort> getSerialPort();
+    CSerialPortFactory() : mReplayTimed(false) { ; };
+
+    // Recorded sessions are served at recorded timing instead of full speed
+    void setReplayTimed(bool b);
+    std::unique_ptr<CSerialPort> getSerialPort(const string & portName);
 };
 
 #endif
@@ -0,0 +1,419 @@
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <netdb.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include <sstream>
+#include <vector>
+#include <chrono>
+
+#include "ExitCodes.hpp"
+#include "SerialPortTcp.hpp"
+#include "Logger.hpp"
+
+using std::ostringstream;
+using std::istringstream;
+using std::vector;
+namespace chrono = std::chrono;
+
+#define DEFAULT_SERIAL_SPEED 19200
+
+// Telnet, RFC 854
+#define TELNET_IAC   255
+#define TELNET_DONT  254
+#define TELNET_DO    253
+#define TELNET_WONT  252
+#define TELNET_WILL  251
+#define TELNET_SB    250
+#define TELNET_SE    240
+
+#define TELNET_OPTION_BINARY  0
+#define TELNET_OPTION_SGA     3
+#define TELNET_OPTION_COMPORT 44
+
+// Client to server COM-PORT-OPTION commands, RFC 2217
+#define COMPORT_SET_BAUDRATE  1
+#define COMPORT_SET_DATASIZE  2
+#define COMPORT_SET_PARITY    3
+#define COMPORT_SET_STOPSIZE  4
+#define COMPORT_SET_CONTROL   5
+#define COMPORT_PURGE_DATA    12
+
+#define COMPORT_PARITY_NONE     1
+#define COMPORT_STOPSIZE_1      1
+#define COMPORT_CONTROL_NO_FLOW 1
+#define COMPORT_CONTROL_DTR_ON  8
+#define COMPORT_CONTROL_DTR_OFF 9
+#define COMPORT_CONTROL_RTS_ON  11
+#define COMPORT_CONTROL_RTS_OFF 12
+#define COMPORT_PURGE_RX        1
+
+// Telnet receiver states
+#define TS_DATA    0
+#define TS_IAC     1
+#define TS_OPTION  2
+#define TS_SB      3
+#define TS_SB_IAC  4
+
+bool
+CSerialPortTcp::isTcpPortName(const string & portName)
+{
+    return (!portName.compare(0, strlen(SERIAL_PORT_TCP_PREFIX), SERIAL_PORT_TCP_PREFIX)
+            || !portName.compare(0, strlen(SERIAL_PORT_RFC2217_PREFIX), SERIAL_PORT_RFC2217_PREFIX));
+}
+
+CSerialPortTcp::CSerialPortTcp()
+{
+    mSocketFd = -1;
+    mPortName = "";
+    mTelnet = false;
+    mRxStart = 0;
+    mRxEnd = 0;
+    mTelnetState = TS_DATA;
+    mTelnetVerb = 0;
+}
+
+CSerialPortTcp::~CSerialPortTcp()
+{
+    if (mSocketFd != -1)
+        ::close(mSocketFd);
+}
+
+void
+CSerialPortTcp::openSocket(string portName)
+{
+    string address;
+
+    mTelnet = !portName.compare(0, strlen(SERIAL_PORT_RFC2217_PREFIX), SERIAL_PORT_RFC2217_PREFIX);
+    if (mTelnet)
+        address = portName.substr(strlen(SERIAL_PORT_RFC2217_PREFIX));
+    else
+        address = portName.substr(strlen(SERIAL_PORT_TCP_PREFIX));
+
+    // Split host and port, host can be IPv6 address in brackets
+    string::size_type c = address.rfind(':');
+    if ((c == string::npos) || (c == 0) || (c == address.length() - 1))
+        CLogger::error("Serial port name " + portName + " is not in format tcp://HOST:PORT or rfc2217://HOST:PORT",
+                       EXIT_SERIAL_PORT);
+    string host = address.substr(0, c);
+    string service = address.substr(c + 1);
+    if ((host[0] == '[') && (host[host.length() - 1] == ']'))
+        host = host.substr(1, host.length() - 2);
+
+    struct addrinfo hints;
+    struct addrinfo *res, *ai;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+
+    int e = getaddrinfo(host.c_str(), service.c_str(), &hints, &res);
+    if (e != 0)
+        CLogger::error("Cannot resolve address of " + portName + ": " + gai_strerror(e), EXIT_SERIAL_PORT);
+
+    for (ai = res; ai != NULL; ai = ai->ai_next) {
+        mSocketFd = socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+        if (mSocketFd == -1)
+            continue;
+        if (connect(mSocketFd, ai->ai_addr, ai->ai_addrlen) == 0)
+            break;
+        ::close(mSocketFd);
+        mSocketFd = -1;
+    }
+    freeaddrinfo(res);
+
+    if (mSocketFd == -1)
+        CLogger::error("Cannot connect to " + portName + ": " + strerror(errno), EXIT_SERIAL_PORT);
+
+    // Every handshake is a few bytes long, do not let them wait for more
+    int one = 1;
+    if (setsockopt(mSocketFd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one)) == -1)
+        CLogger::warning(string("Cannot disable Nagle algorithm: ") + strerror(errno));
+
+    mPortName = portName;
+    mRxStart = 0;
+    mRxEnd = 0;
+    mTelnetState = TS_DATA;
+}
+
+void
+CSerialPortTcp::open(string portName, string speed)
+{
+    this->setDefaultTimeout();
+
+    openSocket(portName);
+
+    if (!mTelnet) {
+        CLogger::info("Connected to " + mPortName + ", serial speed is set by the terminal server");
+        return;
+    }
+
+    istringstream is(speed);
+    uint32_t n;
+    is >> n;
+    if (is.fail() || (n == 0))
+        n = DEFAULT_SERIAL_SPEED;
+
+    // Binary transmission in both directions without go-aheads
+    sendTelnetCommand(TELNET_WILL, TELNET_OPTION_BINARY);
+    sendTelnetCommand(TELNET_DO, TELNET_OPTION_BINARY);
+    sendTelnetCommand(TELNET_WILL, TELNET_OPTION_SGA);
+    sendTelnetCommand(TELNET_DO, TELNET_OPTION_SGA);
+    sendTelnetCommand(TELNET_WILL, TELNET_OPTION_COMPORT);
+    // 8N1 without flow control at requested speed
+    uint8_t b[4] = { (uint8_t) (n >> 24), (uint8_t) (n >> 16), (uint8_t) (n >> 8), (uint8_t) n };
+    sendComPortCommand(COMPORT_SET_BAUDRATE, b, 4);
+    b[0] = 8;
+    sendComPortCommand(COMPORT_SET_DATASIZE, b, 1);
+    b[0] = COMPORT_PARITY_NONE;
+    sendComPortCommand(COMPORT_SET_PARITY, b, 1);
+    b[0] = COMPORT_STOPSIZE_1;
+    sendComPortCommand(COMPORT_SET_STOPSIZE, b, 1);
+    b[0] = COMPORT_CONTROL_NO_FLOW;
+    sendComPortCommand(COMPORT_SET_CONTROL, b, 1);
+
+    ostringstream os;
+    os << "Serial port " << mPortName << " opened at speed " << n << " Bd";
+    CLogger::info(os.str());
+}
+
+string
+CSerialPortTcp::getSpeeds(string portName)
+{
+    if (!portName.compare(0, strlen(SERIAL_PORT_RFC2217_PREFIX), SERIAL_PORT_RFC2217_PREFIX))
+        return "Any baudrate supported by the terminal server port\n";
+    return "Baudrate is set by the terminal server\n";
+}
+
+void
+CSerialPortTcp::close()
+{
+    if (mSocketFd != -1) {
+        if (::close(mSocketFd) == -1)
+            CLogger::error("Cannot close connection to " + mPortName, EXIT_SERIAL_PORT);
+        mSocketFd = -1;
+        mPortName = "";
+    }
+}
+
+void
+CSerialPortTcp::flushInput()
+{
+    uint8_t b[512];
+    ssize_t r;
+
+    mRxStart = 0;
+    mRxEnd = 0;
+    // Throw away data which have already arrived, Telnet commands among
+    // them still have to be processed
+    while ((r = recv(mSocketFd, b, sizeof(b), MSG_DONTWAIT)) > 0) {
+        if (mTelnet)
+            decodeTelnet(b, r);
+    }
+    if (mTelnet) {
+        uint8_t v = COMPORT_PURGE_RX;
+        sendComPortCommand(COMPORT_PURGE_DATA, &v, 1);
+    }
+}
+
+void
+CSerialPortTcp::setModemLine(int line, bool state)
+{
+    if (!mTelnet)
+        CLogger::error("Modem control lines cannot be set over raw TCP connection, use rfc2217://",
+                       EXIT_SERIAL_PORT);
+
+    uint8_t v;
+    if (line & SERIAL_LINE_DTR) {
+        v = state ? COMPORT_CONTROL_DTR_ON : COMPORT_CONTROL_DTR_OFF;
+        sendComPortCommand(COMPORT_SET_CONTROL, &v, 1);
+    }
+    if (line & SERIAL_LINE_RTS) {
+        v = state ? COMPORT_CONTROL_RTS_ON : COMPORT_CONTROL_RTS_OFF;
+        sendComPortCommand(COMPORT_SET_CONTROL, &v, 1);
+    }
+}
+
+void
+CSerialPortTcp::sendRaw(const uint8_t *data, int data_length)
+{
+    for (int i = 0; i < data_length; ) {
+        ssize_t r = send(mSocketFd, data + i, data_length - i, MSG_NOSIGNAL);
+        if (r < 0) {
+            if (errno == EINTR)
+                continue;
+            CLogger::error("Cannot write to " + mPortName + ": " + strerror(errno), EXIT_SERIAL_PORT);
+        }
+        i += r;
+    }
+}
+
+void
+CSerialPortTcp::sendTelnetCommand(uint8_t verb, uint8_t option)
+{
+    uint8_t c[3] = { TELNET_IAC, verb, option };
+    sendRaw(c, 3);
+}
+
+void
+CSerialPortTcp::sendComPortCommand(uint8_t command, const uint8_t *value, int value_length)
+{
+    vector<uint8_t> c;
+
+    c.push_back(TELNET_IAC);
+    c.push_back(TELNET_SB);
+    c.push_back(TELNET_OPTION_COMPORT);
+    c.push_back(command);
+    for (int i = 0; i < value_length; ++i) {
+        c.push_back(value[i]);
+        if (value[i] == TELNET_IAC)
+            c.push_back(TELNET_IAC);
+    }
+    c.push_back(TELNET_IAC);
+    c.push_back(TELNET_SE);
+    sendRaw(c.data(), c.size());
+}
+
+int
+CSerialPortTcp::decodeTelnet(uint8_t *data, int data_length)
+{
+    int o = 0;
+
+    // Decode in place, output is never longer than input
+    for (int i = 0; i < data_length; ++i) {
+        uint8_t b = data[i];
+        switch (mTelnetState) {
+        case TS_DATA:
+            if (b == TELNET_IAC)
+                mTelnetState = TS_IAC;
+            else
+                data[o++] = b;
+            break;
+        case TS_IAC:
+            if (b == TELNET_IAC) {
+                // Escaped 0xFF data byte
+                data[o++] = b;
+                mTelnetState = TS_DATA;
+            } else if ((b == TELNET_WILL) || (b == TELNET_WONT) || (b == TELNET_DO) || (b == TELNET_DONT)) {
+                mTelnetVerb = b;
+                mTelnetState = TS_OPTION;
+            } else if (b == TELNET_SB) {
+                mTelnetState = TS_SB;
+            } else {
+                // Other commands have no argument
+                mTelnetState = TS_DATA;
+            }
+            break;
+        case TS_OPTION:
+            // Refuse options we do not know, accepted ones were already
+            // requested by us
+            if ((mTelnetVerb == TELNET_DO) && (b != TELNET_OPTION_BINARY)
+                && (b != TELNET_OPTION_SGA) && (b != TELNET_OPTION_COMPORT))
+                sendTelnetCommand(TELNET_WONT, b);
+            else if ((mTelnetVerb == TELNET_WILL) && (b != TELNET_OPTION_BINARY)
+                     && (b != TELNET_OPTION_SGA))
+                sendTelnetCommand(TELNET_DONT, b);
+            mTelnetState = TS_DATA;
+            break;
+        case TS_SB:
+            // Server notifications (line and modem state) are ignored
+            if (b == TELNET_IAC)
+                mTelnetState = TS_SB_IAC;
+            break;
+        case TS_SB_IAC:
+            mTelnetState = (b == TELNET_SE) ? TS_DATA : TS_SB;
+            break;
+        }
+    }
+
+    return o;
+}
+
+bool
+CSerialPortTcp::fillRxBuffer(int timeoutMs)
+{
+    chrono::steady_clock::time_point deadline = chrono::steady_clock::now() + chrono::milliseconds(timeoutMs);
+
+    for (;;) {
+        int t = chrono::duration_cast<chrono::milliseconds>(deadline - chrono::steady_clock::now()).count();
+        struct pollfd p;
+        p.fd = mSocketFd;
+        p.events = POLLIN;
+        p.revents = 0;
+
+        int s = poll(&p, 1, (t > 0) ? t : 0);
+        if (s == 0)
+            return false; // Timeout
+        if (s < 0) {
+            if (errno == EINTR)
+                continue;
+            CLogger::error("Cannot read from " + mPortName + ": " + strerror(errno), EXIT_SERIAL_PORT);
+        }
+
+        ssize_t r = recv(mSocketFd, mRxBuffer, sizeof(mRxBuffer), 0);
+        if (r == 0)
+            CLogger::error("Connection to " + mPortName + " closed by the terminal server", EXIT_SERIAL_PORT);
+        if (r < 0) {
+            if (errno == EINTR)
+                continue;
+            CLogger::error("Cannot read from " + mPortName + ": " + strerror(errno), EXIT_SERIAL_PORT);
+        }
+
+        mRxStart = 0;
+        mRxEnd = mTelnet ? decodeTelnet(mRxBuffer, r) : r;
+        // Segment could contain only Telnet commands
+        if (mRxEnd > 0)
+            return true;
+    }
+}
+
+ssize_t
+CSerialPortTcp::readAvailable(uint8_t *data, int data_length, int timeoutMs)
+{
+    if ((mRxStart == mRxEnd) && !fillRxBuffer(timeoutMs))
+        return 0;
+
+    int n = mRxEnd - mRxStart;
+    if (n > data_length)
+        n = data_length;
+    memcpy(data, mRxBuffer + mRxStart, n);
+    mRxStart += n;
+
+    return n;
+}
+
+ssize_t
+CSerialPortTcp::readSingle(uint8_t *data, int data_length)
+{
+    ssize_t r = readAvailable(data, data_length, mReadTimeoutMs);
+
+    if (r == 0)
+        CLogger::error("Timeout occured while reading data from " + mPortName, EXIT_SERIAL_PORT);
+
+    return r;
+}
+
+ssize_t
+CSerialPortTcp::writeSingle(const uint8_t *data, int data_length)
+{
+    if (!mTelnet) {
+        sendRaw(data, data_length);
+        return data_length;
+    }
+
+    // Escape 0xFF data bytes
+    vector<uint8_t> e;
+    e.reserve(data_length + 16);
+    for (int i = 0; i < data_length; ++i) {
+        e.push_back(data[i]);
+        if (data[i] == TELNET_IAC)
+            e.push_back(TELNET_IAC);
+    }
+    sendRaw(e.data(), e.size());
+
+    return data_length;
+}
@@ -0,0 +1,50 @@
+#ifndef SERIAL_PORT_TCP_H
+#define SERIAL_PORT_TCP_H 1
+
+#include "SerialPort.hpp"
+
+#define SERIAL_PORT_TCP_PREFIX     "tcp://"
+#define SERIAL_PORT_RFC2217_PREFIX "rfc2217://"
+
+// Serial port of a terminal server reached over TCP. Data are passed
+// either raw (tcp://host:port) or wrapped in Telnet with the RFC 2217
+// COM-PORT-OPTION (rfc2217://host:port) which also allows to set baudrate
+// and modem control lines of the remote port.
+class CSerialPortTcp : public CSerialPort {
+private:
+    int mSocketFd;
+    string mPortName;
+    bool mTelnet;
+    // Received data already decoded from Telnet stream
+    uint8_t mRxBuffer[4096];
+    int mRxStart;
+    int mRxEnd;
+    // Telnet receiver state
+    int mTelnetState;
+    uint8_t mTelnetVerb;
+
+    void openSocket(string portName);
+    void sendRaw(const uint8_t *data, int data_length);
+    void sendTelnetCommand(uint8_t verb, uint8_t option);
+    void sendComPortCommand(uint8_t command, const uint8_t *value, int value_length);
+    bool fillRxBuffer(int timeoutMs);
+    int decodeTelnet(uint8_t *data, int data_length);
+
+    ssize_t readSingle(uint8_t *data, int data_length);
+    ssize_t writeSingle(const uint8_t *data, int data_length);
+    ssize_t readAvailable(uint8_t *data, int data_length, int timeoutMs);
+public:
+    static bool isTcpPortName(const string & portName);
+
+    CSerialPortTcp();
+    ~CSerialPortTcp();
+
+    void open(string portName, string speed);
+    string getSpeeds(string portName);
+
+    void close();
+    void flushInput();
+    void setModemLine(int line, bool state);
+};
+
+#endif
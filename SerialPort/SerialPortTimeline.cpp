@@ -0,0 +1,82 @@
+#include "SerialPortTimeline.hpp"
+#include "Timeline.hpp"
+
+#define CATEGORY "serial"
+
+CSerialPortTimeline::CSerialPortTimeline(unique_ptr<CSerialPort> port)
+    : mPort(std::move(port))
+{
+}
+
+void
+CSerialPortTimeline::open(string portName, string speed)
+{
+    CTimelineSpan span("open", CATEGORY);
+    mPort->open(portName, speed);
+}
+
+string
+CSerialPortTimeline::getSpeeds(string portName)
+{
+    CTimelineSpan span("get speeds", CATEGORY);
+    return mPort->getSpeeds(portName);
+}
+
+void
+CSerialPortTimeline::close()
+{
+    CTimelineSpan span("close", CATEGORY);
+    mPort->close();
+}
+
+void
+CSerialPortTimeline::flushInput()
+{
+    CTimelineSpan span("flush input", CATEGORY);
+    mPort->flushInput();
+}
+
+void
+CSerialPortTimeline::setModemLine(int line, bool state)
+{
+    CTimelineSpan span("set modem line", CATEGORY);
+    mPort->setModemLine(line, state);
+}
+
+bool
+CSerialPortTimeline::getLineErrors(serial_line_errors_t & errors)
+{
+    return mPort->getLineErrors(errors);
+}
+
+ssize_t
+CSerialPortTimeline::readSingle(uint8_t *data, int data_length)
+{
+    CTimelineSpan span("read", CATEGORY, 0);
+
+    // Timeout may have been changed on the decorator
+    mPort->mReadTimeoutMs = mReadTimeoutMs;
+    ssize_t r = mPort->readSingle(data, data_length);
+    span.setBytes(r);
+    return r;
+}
+
+ssize_t
+CSerialPortTimeline::writeSingle(const uint8_t *data, int data_length)
+{
+    CTimelineSpan span("write", CATEGORY, 0);
+
+    ssize_t w = mPort->writeSingle(data, data_length);
+    span.setBytes(w);
+    return w;
+}
+
+ssize_t
+CSerialPortTimeline::readAvailable(uint8_t *data, int data_length, int timeoutMs)
+{
+    CTimelineSpan span("read available", CATEGORY, 0);
+
+    ssize_t r = mPort->readAvailable(data, data_length, timeoutMs);
+    span.setBytes(r);
+    return r;
+}
@@ -0,0 +1,31 @@
+#ifndef SERIAL_PORT_TIMELINE_H
+#define SERIAL_PORT_TIMELINE_H 1
+
+#include <memory>
+
+#include "SerialPort.hpp"
+
+using std::unique_ptr;
+
+// Decorator of a serial port which adds a timeline span for each call
+// of the decorated port, spans of reads and writes carry byte counts
+class CSerialPortTimeline : public CSerialPort {
+private:
+    unique_ptr<CSerialPort> mPort;
+
+    ssize_t readSingle(uint8_t *data, int data_length);
+    ssize_t writeSingle(const uint8_t *data, int data_length);
+    ssize_t readAvailable(uint8_t *data, int data_length, int timeoutMs);
+public:
+    CSerialPortTimeline(unique_ptr<CSerialPort> port);
+
+    void open(string portName, string speed);
+    string getSpeeds(string portName);
+
+    void close();
+    void flushInput();
+    void setModemLine(int line, bool state);
+    bool getLineErrors(serial_line_errors_t & errors);
+};
+
+#endif
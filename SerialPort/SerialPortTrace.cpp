@@ -0,0 +1,407 @@
+#include <string.h>
+#include <errno.h>
+
+#include <sstream>
+#include <thread>
+
+#include "ExitCodes.hpp"
+#include "ExitException.hpp"
+#include "SerialPortTrace.hpp"
+#include "Logger.hpp"
+
+using std::ostringstream;
+
+// Records are written to the file when the buffer grows over this size
+#define TRACE_BUFFER_SIZE (64 * 1024)
+
+CSerialPortRecorder::CSerialPortRecorder(unique_ptr<CSerialPort> port, const string & fileName)
+    : mPort(std::move(port)), mFileName(fileName)
+{
+    mFile = fopen(fileName.c_str(), "wb");
+    if (mFile == NULL)
+        CLogger::error("Cannot create trace file " + fileName + ": " + strerror(errno),
+                       EXIT_MAIN_FILE_INOUT);
+    mBuffer.reserve(TRACE_BUFFER_SIZE + 1024);
+    mBuffer.insert(mBuffer.end(), SERIAL_TRACE_MAGIC, SERIAL_TRACE_MAGIC + strlen(SERIAL_TRACE_MAGIC));
+    mLast = chrono::steady_clock::now();
+}
+
+CSerialPortRecorder::~CSerialPortRecorder()
+{
+    if (mFile != NULL) {
+        // Errors cannot be reported any more, the trace is only truncated
+        if (!mBuffer.empty())
+            fwrite(mBuffer.data(), 1, mBuffer.size(), mFile);
+        fclose(mFile);
+    }
+}
+
+void
+CSerialPortRecorder::putVarint(uint64_t n)
+{
+    while (n >= 0x80) {
+        mBuffer.push_back((n & 0x7F) | 0x80);
+        n >>= 7;
+    }
+    mBuffer.push_back(n);
+}
+
+void
+CSerialPortRecorder::record(uint8_t type, const uint8_t *data, size_t length)
+{
+    chrono::steady_clock::time_point now = chrono::steady_clock::now();
+
+    mBuffer.push_back(type);
+    putVarint(chrono::duration_cast<chrono::microseconds>(now - mLast).count());
+    mLast = now;
+    if (data != NULL) {
+        putVarint(length);
+        mBuffer.insert(mBuffer.end(), data, data + length);
+    }
+    if (mBuffer.size() >= TRACE_BUFFER_SIZE)
+        flushTrace();
+}
+
+void
+CSerialPortRecorder::record(uint8_t type, const string & data)
+{
+    record(type, (const uint8_t *) data.data(), data.length());
+}
+
+void
+CSerialPortRecorder::flushTrace()
+{
+    size_t w = fwrite(mBuffer.data(), 1, mBuffer.size(), mFile);
+    if (w != mBuffer.size())
+        CLogger::error("Cannot write trace file " + mFileName + ": " + strerror(errno),
+                       EXIT_MAIN_FILE_INOUT);
+    mBuffer.clear();
+}
+
+void
+CSerialPortRecorder::open(string portName, string speed)
+{
+    mPort->open(portName, speed);
+    record(SERIAL_TRACE_OPEN, speed);
+}
+
+string
+CSerialPortRecorder::getSpeeds(string portName)
+{
+    string s = mPort->getSpeeds(portName);
+    record(SERIAL_TRACE_SPEEDS, s);
+    return s;
+}
+
+void
+CSerialPortRecorder::close()
+{
+    mPort->close();
+    record(SERIAL_TRACE_CLOSE, NULL, 0);
+    flushTrace();
+    fflush(mFile);
+}
+
+void
+CSerialPortRecorder::flushInput()
+{
+    mPort->flushInput();
+    record(SERIAL_TRACE_FLUSH, NULL, 0);
+}
+
+void
+CSerialPortRecorder::setModemLine(int line, bool state)
+{
+    uint8_t d[2] = { (uint8_t) line, (uint8_t) state };
+
+    mPort->setModemLine(line, state);
+    record(SERIAL_TRACE_MODEM, d, 2);
+}
+
+bool
+CSerialPortRecorder::getLineErrors(serial_line_errors_t & errors)
+{
+    return mPort->getLineErrors(errors);
+}
+
+ssize_t
+CSerialPortRecorder::readSingle(uint8_t *data, int data_length)
+{
+    ssize_t r;
+
+    // Timeout may have been changed on the decorator
+    mPort->mReadTimeoutMs = mReadTimeoutMs;
+    try {
+        r = mPort->readSingle(data, data_length);
+    } catch (CExitException & e) {
+        uint8_t code = e.getReturnValue();
+        record(SERIAL_TRACE_READ_ERROR, &code, 1);
+        throw;
+    }
+    record(SERIAL_TRACE_READ, data, r);
+    return r;
+}
+
+ssize_t
+CSerialPortRecorder::writeSingle(const uint8_t *data, int data_length)
+{
+    ssize_t w = mPort->writeSingle(data, data_length);
+    record(SERIAL_TRACE_WRITE, data, w);
+    return w;
+}
+
+ssize_t
+CSerialPortRecorder::readAvailable(uint8_t *data, int data_length, int timeoutMs)
+{
+    ssize_t r;
+
+    try {
+        r = mPort->readAvailable(data, data_length, timeoutMs);
+    } catch (CExitException & e) {
+        uint8_t code = e.getReturnValue();
+        record(SERIAL_TRACE_READ_ERROR, &code, 1);
+        throw;
+    }
+    record(SERIAL_TRACE_READ, data, r);
+    return r;
+}
+
+
+bool
+CSerialPortReplay::isReplayPortName(const string & portName)
+{
+    return !portName.compare(0, strlen(SERIAL_PORT_REPLAY_PREFIX), SERIAL_PORT_REPLAY_PREFIX);
+}
+
+CSerialPortReplay::CSerialPortReplay(bool timed)
+{
+    mPos = 0;
+    mType = 0;
+    mDataPos = 0;
+    mDataEnd = 0;
+    mTimed = timed;
+    mTime = chrono::microseconds(0);
+}
+
+void
+CSerialPortReplay::loadTrace(const string & portName)
+{
+    if (!mTrace.empty())
+        return;
+
+    string fileName = portName.substr(strlen(SERIAL_PORT_REPLAY_PREFIX));
+    FILE *f = fopen(fileName.c_str(), "rb");
+    if (f == NULL)
+        CLogger::error("Cannot open trace file " + fileName + ": " + strerror(errno), EXIT_SERIAL_PORT);
+    uint8_t b[4096];
+    size_t r;
+    while ((r = fread(b, 1, sizeof(b), f)) > 0)
+        mTrace.insert(mTrace.end(), b, b + r);
+    bool failed = ferror(f);
+    fclose(f);
+    if (failed)
+        CLogger::error("Cannot read trace file " + fileName, EXIT_SERIAL_PORT);
+
+    size_t l = strlen(SERIAL_TRACE_MAGIC);
+    if ((mTrace.size() < l) || memcmp(mTrace.data(), SERIAL_TRACE_MAGIC, l))
+        CLogger::error("File " + fileName + " is not a serial port trace", EXIT_SERIAL_PORT);
+    mPos = l;
+}
+
+uint64_t
+CSerialPortReplay::getVarint()
+{
+    uint64_t n = 0;
+
+    for (int shift = 0; shift < 64; shift += 7) {
+        if (mPos >= mTrace.size())
+            break;
+        uint8_t b = mTrace[mPos++];
+        n |= ((uint64_t) (b & 0x7F)) << shift;
+        if (!(b & 0x80))
+            return n;
+    }
+    CLogger::error("Trace file is damaged", EXIT_SERIAL_PORT);
+    return 0;
+}
+
+bool
+CSerialPortReplay::nextRecord()
+{
+    // Current record keeps data not yet consumed by the host
+    if (mType != 0)
+        return true;
+    if (mPos >= mTrace.size())
+        return false;
+
+    mType = mTrace[mPos++];
+    mTime += chrono::microseconds(getVarint());
+    mDataPos = mDataEnd = mPos;
+    switch (mType) {
+    case SERIAL_TRACE_CLOSE:
+    case SERIAL_TRACE_FLUSH:
+        break;
+    case SERIAL_TRACE_OPEN:
+    case SERIAL_TRACE_SPEEDS:
+    case SERIAL_TRACE_MODEM:
+    case SERIAL_TRACE_WRITE:
+    case SERIAL_TRACE_READ:
+    case SERIAL_TRACE_READ_ERROR: {
+        uint64_t l = getVarint();
+        if (l > mTrace.size() - mPos)
+            CLogger::error("Trace file is damaged", EXIT_SERIAL_PORT);
+        mDataPos = mPos;
+        mDataEnd = mPos = mPos + l;
+        break;
+    }
+    default:
+        CLogger::error("Trace file is damaged", EXIT_SERIAL_PORT);
+    }
+
+    return true;
+}
+
+void
+CSerialPortReplay::diverged(const string & msg)
+{
+    ostringstream os;
+    os << "Session diverged from the recorded one at trace offset " << mDataPos << ": " << msg;
+    CLogger::error(os.str(), EXIT_SERIAL_PORT);
+}
+
+void
+CSerialPortReplay::expect(uint8_t type, const string & operation)
+{
+    static const struct {
+        uint8_t type;
+        const char *operation;
+    } names[] = {
+        { SERIAL_TRACE_OPEN, "opens port" },
+        { SERIAL_TRACE_SPEEDS, "gets speeds" },
+        { SERIAL_TRACE_CLOSE, "closes port" },
+        { SERIAL_TRACE_FLUSH, "flushes input" },
+        { SERIAL_TRACE_MODEM, "sets modem line" },
+        { SERIAL_TRACE_WRITE, "writes data" },
+        { SERIAL_TRACE_READ, "reads data" },
+        { SERIAL_TRACE_READ_ERROR, "fails to read" }
+    };
+
+    if (!nextRecord())
+        diverged("host " + operation + " after the end of recorded session");
+    if (mType == type)
+        return;
+    for (const auto & n : names) {
+        if (n.type == mType)
+            diverged("host " + operation + " where recorded session " + n.operation);
+    }
+}
+
+void
+CSerialPortReplay::waitForRecordTime()
+{
+    if (mTimed)
+        std::this_thread::sleep_until(mStart + mTime);
+}
+
+void
+CSerialPortReplay::open(string portName, string speed)
+{
+    loadTrace(portName);
+    expect(SERIAL_TRACE_OPEN, "opens port");
+    string s(mTrace.begin() + mDataPos, mTrace.begin() + mDataEnd);
+    if (s != speed)
+        diverged("host sets speed " + speed + " where recorded session sets " + s);
+    // Recorded timing is relative to opening of the port
+    mStart = chrono::steady_clock::now() - mTime;
+    mType = 0;
+}
+
+string
+CSerialPortReplay::getSpeeds(string portName)
+{
+    loadTrace(portName);
+    expect(SERIAL_TRACE_SPEEDS, "gets speeds");
+    mStart = chrono::steady_clock::now() - mTime;
+    mType = 0;
+    return string(mTrace.begin() + mDataPos, mTrace.begin() + mDataEnd);
+}
+
+void
+CSerialPortReplay::close()
+{
+    expect(SERIAL_TRACE_CLOSE, "closes port");
+    mType = 0;
+    if (nextRecord())
+        diverged("host closes port before the end of recorded session");
+}
+
+void
+CSerialPortReplay::flushInput()
+{
+    expect(SERIAL_TRACE_FLUSH, "flushes input");
+    waitForRecordTime();
+    mType = 0;
+}
+
+void
+CSerialPortReplay::setModemLine(int line, bool state)
+{
+    expect(SERIAL_TRACE_MODEM, "sets modem line");
+    if ((mDataEnd - mDataPos != 2) || (mTrace[mDataPos] != line) || (mTrace[mDataPos + 1] != state))
+        diverged("host sets modem line differently");
+    waitForRecordTime();
+    mType = 0;
+}
+
+ssize_t
+CSerialPortReplay::readSingle(uint8_t *data, int data_length)
+{
+    return readAvailable(data, data_length, mReadTimeoutMs);
+}
+
+ssize_t
+CSerialPortReplay::writeSingle(const uint8_t *data, int data_length)
+{
+    // Host may split or join writes differently, data are compared as
+    // a stream up to the next recorded read
+    for (int i = 0; i < data_length; ) {
+        expect(SERIAL_TRACE_WRITE, "writes data");
+        for ( ; (i < data_length) && (mDataPos < mDataEnd); ++i, ++mDataPos) {
+            if (data[i] != mTrace[mDataPos]) {
+                diverged("host writes " + CLogger::decToHex(data[i]) + " where recorded session writes "
+                         + CLogger::decToHex(mTrace[mDataPos]));
+            }
+        }
+        if (mDataPos == mDataEnd) {
+            waitForRecordTime();
+            mType = 0;
+        }
+    }
+
+    return data_length;
+}
+
+ssize_t
+CSerialPortReplay::readAvailable(uint8_t *data, int data_length, int timeoutMs)
+{
+    if (nextRecord() && (mType == SERIAL_TRACE_READ_ERROR)) {
+        int code = (mDataEnd > mDataPos) ? mTrace[mDataPos] : EXIT_SERIAL_PORT;
+        waitForRecordTime();
+        mType = 0;
+        CLogger::error("Reading from serial port failed in the recorded session", code);
+    }
+    expect(SERIAL_TRACE_READ, "reads data");
+    waitForRecordTime();
+
+    // Timeout of the recorded session is an empty record, a longer record
+    // is served by parts
+    ssize_t r = mDataEnd - mDataPos;
+    if (r > data_length)
+        r = data_length;
+    memcpy(data, mTrace.data() + mDataPos, r);
+    mDataPos += r;
+    if (mDataPos == mDataEnd)
+        mType = 0;
+
+    return r;
+}
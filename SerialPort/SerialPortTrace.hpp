@@ -0,0 +1,106 @@
+#ifndef SERIAL_PORT_TRACE_H
+#define SERIAL_PORT_TRACE_H 1
+
+#include <cstdio>
+#include <vector>
+#include <memory>
+#include <chrono>
+
+#include "SerialPort.hpp"
+
+using std::vector;
+using std::unique_ptr;
+namespace chrono = std::chrono;
+
+#define SERIAL_PORT_REPLAY_PREFIX "replay://"
+
+// Trace of a serial port session. The file starts with SERIAL_TRACE_MAGIC
+// and continues with records:
+//
+//   type (1 byte), time since the previous record in us (varint)
+//   and for records with data: length (varint), data
+//
+// Varints are little endian base 128 numbers as in LEB128. Time of a
+// record is taken when the call returns.
+#define SERIAL_TRACE_MAGIC     "ST10TRC1"
+
+#define SERIAL_TRACE_OPEN       'O' // Data: speed
+#define SERIAL_TRACE_SPEEDS     'S' // Data: returned list of speeds
+#define SERIAL_TRACE_CLOSE      'C'
+#define SERIAL_TRACE_FLUSH      'F'
+#define SERIAL_TRACE_MODEM      'M' // Data: line, state
+#define SERIAL_TRACE_WRITE      'W' // Data: bytes accepted by the port
+#define SERIAL_TRACE_READ       'R' // Data: bytes received, none on timeout
+#define SERIAL_TRACE_READ_ERROR 'E' // Data: exit code of failed read
+
+// Decorator of a serial port which records every call to a trace file.
+// Records are buffered, the file is written in large chunks.
+class CSerialPortRecorder : public CSerialPort {
+private:
+    unique_ptr<CSerialPort> mPort;
+    FILE *mFile;
+    string mFileName;
+    vector<uint8_t> mBuffer;
+    chrono::steady_clock::time_point mLast;
+
+    void putVarint(uint64_t n);
+    void record(uint8_t type, const uint8_t *data, size_t length);
+    void record(uint8_t type, const string & data);
+    void flushTrace();
+
+    ssize_t readSingle(uint8_t *data, int data_length);
+    ssize_t writeSingle(const uint8_t *data, int data_length);
+    ssize_t readAvailable(uint8_t *data, int data_length, int timeoutMs);
+public:
+    CSerialPortRecorder(unique_ptr<CSerialPort> port, const string & fileName);
+    ~CSerialPortRecorder();
+
+    void open(string portName, string speed);
+    string getSpeeds(string portName);
+
+    void close();
+    void flushInput();
+    void setModemLine(int line, bool state);
+    bool getLineErrors(serial_line_errors_t & errors);
+};
+
+// Serial port serving a recorded session back to the host. Data written
+// by the host must match the recorded ones, the session fails with the
+// first difference. Data are read as fast as requested or, when timed,
+// not sooner than they were received in the recorded session.
+class CSerialPortReplay : public CSerialPort {
+private:
+    vector<uint8_t> mTrace;
+    size_t mPos;
+    // Current record, data not yet consumed by the host
+    uint8_t mType;
+    size_t mDataPos;
+    size_t mDataEnd;
+    bool mTimed;
+    chrono::microseconds mTime;
+    chrono::steady_clock::time_point mStart;
+
+    void loadTrace(const string & portName);
+    uint64_t getVarint();
+    bool nextRecord();
+    void expect(uint8_t type, const string & operation);
+    void diverged(const string & msg);
+    void waitForRecordTime();
+
+    ssize_t readSingle(uint8_t *data, int data_length);
+    ssize_t writeSingle(const uint8_t *data, int data_length);
+    ssize_t readAvailable(uint8_t *data, int data_length, int timeoutMs);
+public:
+    static bool isReplayPortName(const string & portName);
+
+    CSerialPortReplay(bool timed);
+
+    void open(string portName, string speed);
+    string getSpeeds(string portName);
+
+    void close();
+    void flushInput();
+    void setModemLine(int line, bool state);
+};
+
+#endif
@@ -5,7 +5,11 @@
 #include <errno.h>   /* Error number definitions */
 #include <termios.h>
 #include <sys/select.h>
+#include <sys/ioctl.h>
 #include <errno.h>
+#ifdef __linux__
+#include <linux/serial.h>  /* struct serial_icounter_struct */
+#endif
 
 #include <sstream>
 #include <iostream>
@@ -27,6 +31,7 @@ CSerialPortUnix::CSerialPortUnix()
 {
     mSerialPortFd = -1;
     mPortName = "";
+    mHasCounters = false;
     // Construct vector of available system baudrates
 #ifdef B50
     mBaudrates.push_back(pair<string, speed_t>("50", B50));
@@ -86,7 +91,9 @@ CSerialPortUnix::CSerialPortUnix()
 
 CSerialPortUnix::~CSerialPortUnix()
 {
-    ;
+    // Do not leak descriptor when operation ends with an exception
+    if (mSerialPortFd != -1)
+        ::close(mSerialPortFd);
 }
 
 void
@@ -130,6 +137,8 @@ CSerialPortUnix::open(string portName, string speed)
     tcsetattr(mSerialPortFd, TCSANOW, &options);
     // Blocking read
     fcntl(mSerialPortFd, F_SETFL, 0);
+    // Errors are reported relative to the open, not since boot
+    mHasCounters = readCounters(mOpenCounters);
     
     CLogger::info("Serial port " + mPortName + " opened at speed " + s.first + " Bd");
 }
@@ -139,6 +148,9 @@ CSerialPortUnix::close()
 {
     // Close only valid descriptor
     if (mSerialPortFd != -1) {
+        string e = getLineErrorsMessage();
+        if (!e.empty())
+            CLogger::info("Serial port " + mPortName + " received with " + e);
 	if (::close(mSerialPortFd) == -1)
 	    CLogger::error("Cannot close serial port", EXIT_SERIAL_PORT);
 	mSerialPortFd = -1;
@@ -230,7 +242,7 @@ CSerialPortUnix::setSpeed(pair<string, speed_t> speed)
 
 
 ssize_t
-CSerialPortUnix::writeSingle(uint8_t *data, int data_length)
+CSerialPortUnix::writeSingle(const uint8_t *data, int data_length)
 {
     ssize_t r = ::write(mSerialPortFd, data, data_length);
 
@@ -247,6 +259,22 @@ CSerialPortUnix::writeSingle(uint8_t *data, int data_length)
 
 ssize_t
 CSerialPortUnix::readSingle(uint8_t *data, int data_length)
+{
+    ssize_t r = readAvailable(data, data_length, mReadTimeoutMs);
+
+    if (r == 0) {
+        // Timeout occured, data may have been lost by the host UART
+        string e = getLineErrorsMessage();
+        if (!e.empty())
+            e = ", host serial port reports " + e;
+        CLogger::error("Timeout occured while reading data from serial port" + e, EXIT_SERIAL_PORT);
+    }
+
+    return r;
+}
+
+ssize_t
+CSerialPortUnix::readAvailable(uint8_t *data, int data_length, int timeoutMs)
 {
     ssize_t r = 0;
     int s;
@@ -259,8 +287,8 @@ CSerialPortUnix::readSingle(uint8_t *data, int data_length)
     FD_ZERO(&except_fds);
     FD_SET(mSerialPortFd, &read_fds);
     // Set timeout
-    timeout.tv_sec = mReadTimeoutMs / 1000;
-    timeout.tv_usec = 0;
+    timeout.tv_sec = timeoutMs / 1000;
+    timeout.tv_usec = (timeoutMs % 1000) * 1000;
     // Wait for event
     s = select(mSerialPortFd + 1, &read_fds, &write_fds, &except_fds, &timeout);
     if (s == 1) {
@@ -268,18 +296,87 @@ CSerialPortUnix::readSingle(uint8_t *data, int data_length)
         r = ::read(mSerialPortFd, data, data_length);
     } else if (s == 0) {
         // Timeout occured
-        CLogger::error("Timeout occured while reading data from serial port", EXIT_SERIAL_PORT);
-    } 
+        return 0;
+    }
     
-    if ((s < 0) || (r <= 0)) {
+    if ((s < 0) || (r < 0)) {
         // Error occured in select or read
         ostringstream os;
-        os << "Cannot read from serial port";
-        if (r < 0) {
-            os << ": " <<  strerror(errno);
-            CLogger::error(os.str(), EXIT_SERIAL_PORT);
-        }
+        os << "Cannot read from serial port: " << strerror(errno);
+        CLogger::error(os.str(), EXIT_SERIAL_PORT);
     }
 
     return r;
 }
+
+bool
+CSerialPortUnix::readCounters(serial_line_errors_t & counters)
+{
+#if defined(__linux__) && defined(TIOCGICOUNT)
+    struct serial_icounter_struct c;
+
+    // Pseudo-terminals and some USB adapters do not count errors
+    if (ioctl(mSerialPortFd, TIOCGICOUNT, &c) == -1)
+        return false;
+    counters.overrun = c.overrun;
+    counters.frame = c.frame;
+    counters.parity = c.parity;
+    counters.brk = c.brk;
+    counters.bufOverrun = c.buf_overrun;
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool
+CSerialPortUnix::getLineErrors(serial_line_errors_t & errors)
+{
+    serial_line_errors_t c;
+
+    if (!mHasCounters || (mSerialPortFd == -1) || !readCounters(c))
+        return false;
+    errors.overrun = c.overrun - mOpenCounters.overrun;
+    errors.frame = c.frame - mOpenCounters.frame;
+    errors.parity = c.parity - mOpenCounters.parity;
+    errors.brk = c.brk - mOpenCounters.brk;
+    errors.bufOverrun = c.bufOverrun - mOpenCounters.bufOverrun;
+    return true;
+}
+
+string
+CSerialPortUnix::getLineErrorsMessage()
+{
+    serial_line_errors_t e;
+
+    if (!getLineErrors(e))
+        return "";
+    return describeLineErrors(e);
+}
+
+void
+CSerialPortUnix::flushInput()
+{
+    if (tcflush(mSerialPortFd, TCIFLUSH) == -1) {
+        ostringstream os;
+        os << "Cannot flush input of serial port " << mPortName << ": " << strerror(errno);
+        CLogger::error(os.str(), EXIT_SERIAL_PORT);
+    }
+}
+
+void
+CSerialPortUnix::setModemLine(int line, bool state)
+{
+    int bits = 0;
+
+    if (line & SERIAL_LINE_DTR)
+        bits |= TIOCM_DTR;
+    if (line & SERIAL_LINE_RTS)
+        bits |= TIOCM_RTS;
+
+    if (ioctl(mSerialPortFd, state ? TIOCMBIS : TIOCMBIC, &bits) == -1) {
+        ostringstream os;
+        os << "Cannot set modem control lines of serial port " << mPortName << ": " << strerror(errno);
+        CLogger::error(os.str(), EXIT_SERIAL_PORT);
+    }
+}
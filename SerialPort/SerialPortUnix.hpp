@@ -14,14 +14,20 @@ private:
     int mSerialPortFd;
     string mPortName;
     vector< pair<string, speed_t> > mBaudrates;
+    // Error counters of the driver sampled at open
+    bool mHasCounters;
+    serial_line_errors_t mOpenCounters;
 
     vector<pair<string, speed_t>> getDeviceSpeeds();
     pair<string, speed_t> findSpeed(string speed, const vector<pair<string, speed_t>> & list);
     void setSpeed(pair<string, speed_t> speed);
     void openPort(string portName);
+    bool readCounters(serial_line_errors_t & counters);
+    string getLineErrorsMessage();
 
     ssize_t readSingle(uint8_t *data, int data_length);
-    ssize_t writeSingle(uint8_t *data, int data_length);
+    ssize_t writeSingle(const uint8_t *data, int data_length);
+    ssize_t readAvailable(uint8_t *data, int data_length, int timeoutMs);
 public:
     CSerialPortUnix();
     ~CSerialPortUnix();
@@ -30,6 +36,9 @@ public:
     string getSpeeds(string portName);
 
     void close();
+    void flushInput();
+    void setModemLine(int line, bool state);
+    bool getLineErrors(serial_line_errors_t & errors);
 };
 
 #endif
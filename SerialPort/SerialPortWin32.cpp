@@ -206,9 +206,31 @@ CSerialPortWin32::setTimeouts(int ms)
                        EXIT_SERIAL_PORT);
     }
 }
-    
+
+void
+CSerialPortWin32::setAvailableTimeout(int ms)
+{
+    COMMTIMEOUTS timeouts;
+
+    if (!GetCommTimeouts(mSerialPortH, &timeouts)) {
+        CLogger::error("Cannot get timeouts for serial port: " + getLastErrorAsString(),
+                       EXIT_SERIAL_PORT);
+    }
+
+    // ReadFile returns as soon as any byte is received, or after ms
+    // when nothing arrives, regardless of the requested length
+    timeouts.ReadIntervalTimeout = MAXDWORD;
+    timeouts.ReadTotalTimeoutMultiplier = MAXDWORD;
+    timeouts.ReadTotalTimeoutConstant = (ms > 0) ? ms : 1;
+
+    if (!SetCommTimeouts(mSerialPortH, &timeouts)) {
+        CLogger::error("Cannot set timeouts for port: " + getLastErrorAsString(),
+                       EXIT_SERIAL_PORT);
+    }
+}
+
 ssize_t
-CSerialPortWin32::writeSingle(uint8_t *data, int data_length)
+CSerialPortWin32::writeSingle(const uint8_t *data, int data_length)
 {   
     DWORD written = 0;
 
@@ -236,3 +258,37 @@ CSerialPortWin32::readSingle(uint8_t *data, int data_length)
     
     return read;
 }
+
+ssize_t
+CSerialPortWin32::readAvailable(uint8_t *data, int data_length, int timeoutMs)
+{
+    DWORD read;
+
+    setAvailableTimeout(timeoutMs);
+
+    if (!ReadFile(mSerialPortH, data, data_length, &read, NULL)) {
+        CLogger::error("Cannot read data from serial port: " + getLastErrorAsString(),
+                       EXIT_SERIAL_PORT);
+    }
+
+    return read;
+}
+
+void
+CSerialPortWin32::flushInput()
+{
+    if (!PurgeComm(mSerialPortH, PURGE_RXCLEAR)) {
+        CLogger::error("Cannot flush input of serial port: " + getLastErrorAsString(),
+                       EXIT_SERIAL_PORT);
+    }
+}
+
+void
+CSerialPortWin32::setModemLine(int line, bool state)
+{
+    if (((line & SERIAL_LINE_DTR) && !EscapeCommFunction(mSerialPortH, state ? SETDTR : CLRDTR))
+        || ((line & SERIAL_LINE_RTS) && !EscapeCommFunction(mSerialPortH, state ? SETRTS : CLRRTS))) {
+        CLogger::error("Cannot set modem control lines of serial port: " + getLastErrorAsString(),
+                       EXIT_SERIAL_PORT);
+    }
+}
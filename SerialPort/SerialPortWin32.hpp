@@ -30,10 +30,12 @@ private:
     void openPort(string portName);
     s_speed  getMaxSpeed(string portName);
     void setTimeouts(int ms);
+    void setAvailableTimeout(int ms);
     string getLastErrorAsString();
   
     ssize_t readSingle(uint8_t *data, int data_length);
-    ssize_t writeSingle(uint8_t *data, int data_length);
+    ssize_t writeSingle(const uint8_t *data, int data_length);
+    ssize_t readAvailable(uint8_t *data, int data_length, int timeoutMs);
 public:
     CSerialPortWin32();
     ~CSerialPortWin32();
@@ -42,7 +44,9 @@ public:
     string getSpeeds(string portName);
   
     void close();
-    void write(uint8_t *data, int data_length, int padd_to);
+    void flushInput();
+    void setModemLine(int line, bool state);
+    void write(const uint8_t *data, int data_length, int padd_to);
     void read(uint8_t *data, int data_length);
 };
 
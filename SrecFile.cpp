@@ -0,0 +1,208 @@
+#include "SrecFile.hpp"
+#include "ExitCodes.hpp"
+#include "Logger.hpp"
+
+#define SREC_MAX_BYTES     255
+// Data bytes per written record, line fits in 80 characters for S3
+#define SREC_LINE_DATA     32
+
+bool
+CSrecFile::hasSrecExtension(const string & fpath)
+{
+    static const char * const ext[] = { ".s19", ".S19", ".s28", ".S28", ".s37", ".S37",
+                                        ".srec", ".SREC", ".mot", ".MOT", 0 };
+    return hasExtension(fpath, ext);
+}
+
+CSrecFile::CSrecFile(const string & fpath)
+    : CRecordFile(fpath), mDataRecords(0), mEof(false)
+{
+    ;
+}
+
+void
+CSrecFile::finish()
+{
+    if (!mEof)
+        CLogger::warning("File " + mPath + " has no termination record");
+}
+
+void
+CSrecFile::parseRecord(const char *s, size_t length, CImage & image)
+{
+    uint8_t b[SREC_MAX_BYTES + 1];
+
+    // Ignore line ending and empty lines
+    while ((length > 0) && ((s[length - 1] == '\r') || (s[length - 1] == ' ') || (s[length - 1] == '\t')))
+        --length;
+    if (length == 0)
+        return;
+    if (mEof)
+        recordError("Data after termination record");
+    if ((s[0] != 'S') && (s[0] != 's'))
+        recordError("Record does not start with 'S'");
+    if ((length % 2 != 0) || (length < 10))
+        recordError("Bad record length");
+
+    // Decode bytes: count, address, data, checksum
+    size_t n = (length - 2) / 2;
+    if (n > sizeof(b))
+        recordError("Bad record length");
+    decodeBytes(s + 2, n, b);
+    uint8_t sum = 0;
+    for (size_t i = 0; i < n; ++i)
+        sum += b[i];
+    if (b[0] + 1u != n)
+        recordError("Byte count does not match record length");
+    if (sum != 0xFF)
+        recordError("Bad checksum");
+
+    // Address width by record type
+    size_t aw;
+    switch (s[1]) {
+    case '0': case '1': case '5': case '9':
+        aw = 2;
+        break;
+    case '2': case '6': case '8':
+        aw = 3;
+        break;
+    case '3': case '7':
+        aw = 4;
+        break;
+    default:
+        recordError(string("Unknown record type S") + s[1]);
+        return;
+    }
+    if (n < aw + 2)
+        recordError("Bad record length");
+
+    uint32_t address = 0;
+    for (size_t i = 0; i < aw; ++i)
+        address = (address << 8) | b[1 + i];
+    uint8_t *data = b + 1 + aw;
+    size_t count = n - aw - 2;
+
+    switch (s[1]) {
+    case '1': case '2': case '3':
+        if ((uint64_t) address + count > 0x100000000ull)
+            recordError("Data exceed 32-bit address space");
+        image.addData(address, data, count);
+        ++mDataRecords;
+        break;
+    case '5': case '6':
+        // Record count is optional, check only when present
+        if (address != (mDataRecords & (aw == 2 ? 0xFFFF : 0xFFFFFF)))
+            recordError("Record count does not match number of data records");
+        break;
+    case '7': case '8': case '9':
+        // Start address has no meaning for FLASH memory
+        mEof = true;
+        break;
+    default:
+        // S0 header carries no data
+        break;
+    }
+}
+
+CSrecWriter::CSrecWriter(const string & fpath, CDataSink & out)
+    : mOut(out), mType(1), mAddress(0), mRecords(0)
+{
+    // Header record holds file name
+    mName = fpath.substr(fpath.find_last_of("/\\") + 1);
+    if (mName.size() > SREC_LINE_DATA)
+        mName.resize(SREC_LINE_DATA);
+
+    static const char * const ext28[] = { ".s28", ".S28", 0 };
+    static const char * const ext37[] = { ".s37", ".S37", 0 };
+    if (CRecordFile::hasExtension(fpath, ext37))
+        mType = 3;
+    else if (CRecordFile::hasExtension(fpath, ext28))
+        mType = 2;
+}
+
+void
+CSrecWriter::record(char type, int addressWidth, uint32_t address,
+                    const uint8_t *data, size_t length)
+{
+    static const char digits[] = "0123456789ABCDEF";
+    uint8_t count = addressWidth + length + 1;
+    uint8_t sum = count;
+
+    mText += 'S';
+    mText += type;
+    mText += digits[count >> 4];
+    mText += digits[count & 0xF];
+    for (int i = addressWidth - 1; i >= 0; --i) {
+        uint8_t v = address >> (8 * i);
+        sum += v;
+        mText += digits[v >> 4];
+        mText += digits[v & 0xF];
+    }
+    for (size_t i = 0; i < length; ++i) {
+        sum += data[i];
+        mText += digits[data[i] >> 4];
+        mText += digits[data[i] & 0xF];
+    }
+    sum = ~sum;
+    mText += digits[sum >> 4];
+    mText += digits[sum & 0xF];
+    mText += '\n';
+}
+
+void
+CSrecWriter::flushText()
+{
+    mOut.write((const uint8_t *) mText.data(), mText.size());
+    mText.clear();
+}
+
+void
+CSrecWriter::begin(uint32_t length)
+{
+    if (length > 0x1000000)
+        mType = 3;
+    else if ((length > 0x10000) && (mType < 2))
+        mType = 2;
+
+    // Text is about 2.3 times longer than data
+    mOut.begin(length / SREC_LINE_DATA * (2 * SREC_LINE_DATA + 2 * mType + 9) + 64);
+    record('0', 2, 0, (const uint8_t *) mName.data(), mName.size());
+}
+
+void
+CSrecWriter::write(const uint8_t *data, uint32_t length)
+{
+    while (length > 0) {
+        uint32_t n = SREC_LINE_DATA - mPending.size();
+        if (n > length)
+            n = length;
+        mPending.insert(mPending.end(), data, data + n);
+        data += n;
+        length -= n;
+        if (mPending.size() == SREC_LINE_DATA) {
+            record('0' + mType, mType + 1, mAddress, mPending.data(), mPending.size());
+            mAddress += mPending.size();
+            ++mRecords;
+            mPending.clear();
+        }
+    }
+    flushText();
+}
+
+void
+CSrecWriter::end()
+{
+    if (!mPending.empty()) {
+        record('0' + mType, mType + 1, mAddress, mPending.data(), mPending.size());
+        mAddress += mPending.size();
+        ++mRecords;
+        mPending.clear();
+    }
+    if (mRecords <= 0xFFFF)
+        record('5', 2, mRecords, 0, 0);
+    else if (mRecords <= 0xFFFFFF)
+        record('6', 3, mRecords, 0, 0);
+    record('0' + 10 - mType, mType + 1, 0, 0, 0);
+    flushText();
+    mOut.end();
+}
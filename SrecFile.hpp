@@ -0,0 +1,47 @@
+#ifndef SREC_FILE_HPP
+#define SREC_FILE_HPP 1
+
+#include "RecordFile.hpp"
+#include "DataSink.hpp"
+
+// Motorola S-record reader (S19, S28 and S37 variants)
+class CSrecFile : public CRecordFile {
+private:
+    unsigned long mDataRecords;
+    bool mEof;
+
+    void parseRecord(const char *s, size_t length, CImage & image);
+    void finish();
+
+public:
+    static bool hasSrecExtension(const string & fpath);
+
+    CSrecFile(const string & fpath);
+};
+
+// Formats data from address 0 as S-records and passes them to another sink.
+// Address width is the smallest one covering all data, at least the width
+// implied by extension of the file name.
+class CSrecWriter : public CDataSink {
+private:
+    string mName;
+    CDataSink & mOut;
+    int mType;
+    uint32_t mAddress;
+    unsigned long mRecords;
+    // Data of incomplete record
+    vector<uint8_t> mPending;
+    string mText;
+
+    void record(char type, int addressWidth, uint32_t address,
+                const uint8_t *data, size_t length);
+    void flushText();
+
+public:
+    CSrecWriter(const string & fpath, CDataSink & out);
+    void begin(uint32_t length);
+    void write(const uint8_t *data, uint32_t length);
+    void end();
+};
+
+#endif
@@ -0,0 +1,140 @@
+#include "Station.hpp"
+#include "ExitCodes.hpp"
+#include "ExitException.hpp"
+#include "Logger.hpp"
+
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <fnmatch.h>
+#include <sys/inotify.h>
+
+#include <sstream>
+#include <thread>
+#include <chrono>
+#include <iomanip>
+#include <system_error>
+
+using std::ostringstream;
+using std::thread;
+using std::mutex;
+using std::lock_guard;
+using std::unique_lock;
+using std::fixed;
+using std::setprecision;
+namespace chrono = std::chrono;
+
+#define STATION_SETTLE_DELAY 500 // ms, udev sets device permissions meanwhile
+
+CStation::CStation(const string & directory, const string & pattern, job_t job)
+    : mDirectory(directory), mPattern(pattern), mJob(job), mSucceeded(0), mFailed(0)
+{
+    ;
+}
+
+unsigned int
+CStation::run(unsigned int count)
+{
+    int fd = inotify_init();
+
+    if (fd == -1)
+        CLogger::error(string("Cannot initialize inotify: ") + strerror(errno), EXIT_MAIN_STATION);
+    if (inotify_add_watch(fd, mDirectory.c_str(), IN_CREATE | IN_MOVED_TO) == -1) {
+        ::close(fd);
+        CLogger::error("Cannot watch directory " + mDirectory + ": " + strerror(errno), EXIT_MAIN_STATION);
+    }
+
+    CLogger::message("Waiting for devices " + mDirectory + "/" + mPattern);
+
+    unsigned int started = 0;
+    alignas(struct inotify_event) char buf[4096];
+
+    while ((count == 0) || (started < count)) {
+        ssize_t n = ::read(fd, buf, sizeof(buf));
+        if (n < 0) {
+            if (errno == EINTR)
+                continue;
+            ::close(fd);
+            CLogger::error(string("Cannot read inotify events: ") + strerror(errno), EXIT_MAIN_STATION);
+        }
+        // Process all events of the batch
+        for (char *p = buf; p < buf + n; ) {
+            struct inotify_event *e = (struct inotify_event *) p;
+            p += sizeof(struct inotify_event) + e->len;
+
+            if ((e->len > 0) && (fnmatch(mPattern.c_str(), e->name, 0) == 0)
+                && ((count == 0) || (started < count))) {
+                startJob(e->name);
+                ++started;
+            }
+        }
+    }
+    ::close(fd);
+
+    // Wait for running jobs
+    unique_lock<mutex> lock(mMutex);
+    while (!mBusyDevices.empty())
+        mJobFinished.wait(lock);
+
+    ostringstream os;
+    os << "Station finished: " << mSucceeded << " boards programmed, " << mFailed << " failed";
+    CLogger::message(os.str());
+
+    return mFailed;
+}
+
+void
+CStation::startJob(const string & deviceName)
+{
+    lock_guard<mutex> lock(mMutex);
+
+    // The same device can appear again only after its job has finished
+    if (mBusyDevices.count(deviceName) != 0)
+        return;
+    mBusyDevices.insert(deviceName);
+    try {
+        thread(&CStation::runJob, this, deviceName).detach();
+    } catch (std::system_error & e) {
+        // Other boards keep running, this one is not served
+        CLogger::message(deviceName + ": FAILED, cannot start job: " + e.what());
+        mBusyDevices.erase(deviceName);
+        ++mFailed;
+    }
+}
+
+void
+CStation::runJob(const string & deviceName)
+{
+    string devicePath = mDirectory + "/" + deviceName;
+    bool ok = false;
+
+    CLogger::setPrefix(deviceName + ": ");
+    CLogger::message("New device " + devicePath);
+    std::this_thread::sleep_for(chrono::milliseconds(STATION_SETTLE_DELAY));
+
+    chrono::steady_clock::time_point start = chrono::steady_clock::now();
+    try {
+        uint32_t bytes = mJob(devicePath);
+        double s = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        ostringstream os;
+        os << fixed << setprecision(1);
+        os << "Done, " << bytes << " B in " << s << " s (" << (s > 0 ? bytes / s : 0) << " B/s)";
+        CLogger::message(os.str());
+        ok = true;
+    } catch (CExitException & e) {
+        ostringstream os;
+        os << "FAILED with exit code " << e.getReturnValue();
+        CLogger::message(os.str());
+    } catch (std::exception & e) {
+        // Failure of one board must not terminate the station
+        CLogger::message(string("FAILED: ") + e.what());
+    }
+
+    lock_guard<mutex> lock(mMutex);
+    if (ok)
+        ++mSucceeded;
+    else
+        ++mFailed;
+    mBusyDevices.erase(deviceName);
+    mJobFinished.notify_all();
+}
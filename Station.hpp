@@ -0,0 +1,41 @@
+#ifndef STATION_HPP
+#define STATION_HPP 1
+
+#include <iostream>
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+#include <set>
+
+using std::string;
+using std::set;
+
+// Programming station. Watches a directory for newly created serial port
+// devices and runs a job on each of them in its own thread.
+class CStation {
+public:
+    // Job programs MCU connected to the given device, returns number of
+    // bytes transferred
+    typedef std::function<uint32_t (const string & devicePath)> job_t;
+
+private:
+    string mDirectory;
+    string mPattern;
+    job_t mJob;
+
+    std::mutex mMutex;
+    std::condition_variable mJobFinished;
+    set<string> mBusyDevices;
+    unsigned int mSucceeded;
+    unsigned int mFailed;
+
+    void startJob(const string & deviceName);
+    void runJob(const string & deviceName);
+
+public:
+    CStation(const string & directory, const string & pattern, job_t job);
+
+    unsigned int run(unsigned int count);
+};
+
+#endif
@@ -0,0 +1,242 @@
+#include "Stats.hpp"
+#include "Logger.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <iomanip>
+
+using std::ostringstream;
+using std::setw;
+using std::fixed;
+using std::setprecision;
+using std::left;
+
+// Default speed of serial port backends
+#define DEFAULT_LINE_SPEED 19200
+// Start, 8 data bits and stop bit
+#define BITS_PER_BYTE 10
+
+static const char *phaseNames[STATS_PHASE_COUNT] = {
+    "open", "bootstrap", "ident", "stage 2 upload", "erase", "transfer", "verify"
+};
+
+// Names of timeline events of the "uart" category
+static const char *uartErrorNames[STATS_UART_ERROR_COUNT] = {
+    "overrun", "framing error", "parity error", "break", "buffer overrun"
+};
+
+static const unsigned int rttBounds[STATS_RTT_BUCKET_COUNT - 1] = STATS_RTT_BUCKETS;
+
+bool CStats::mPrint = false;
+string CStats::mJsonFileName;
+uint32_t CStats::mLineRate = DEFAULT_LINE_SPEED / BITS_PER_BYTE;
+
+void
+CStats::enable(bool print, const string & jsonFileName, const string & speed)
+{
+    mPrint = print;
+    mJsonFileName = jsonFileName;
+    unsigned long s = strtoul(speed.c_str(), NULL, 10);
+    mLineRate = ((s == 0) ? DEFAULT_LINE_SPEED : s) / BITS_PER_BYTE;
+}
+
+bool
+CStats::isEnabled()
+{
+    return mPrint || !mJsonFileName.empty();
+}
+
+const string &
+CStats::getJsonFileName()
+{
+    return mJsonFileName;
+}
+
+bool
+CStats::report()
+{
+    vector<timeline_span_t> spans = CTimeline::getSpans();
+    if (!isEnabled() || spans.empty())
+        return true;
+
+    CStats stats(spans);
+    if (mPrint)
+        stats.print();
+    if (!mJsonFileName.empty())
+        return stats.save(mJsonFileName);
+    return true;
+}
+
+static double
+seconds(chrono::steady_clock::duration d)
+{
+    return chrono::duration_cast<chrono::microseconds>(d).count() / 1e6;
+}
+
+CStats::CStats(const vector<timeline_span_t> & spans)
+{
+    mWall = 0;
+    for (int i = 0; i < STATS_PHASE_COUNT; ++i)
+        mPhases[i] = 0;
+    mPayloadBytes = 0;
+    mPayloadTime = 0;
+    memset(mRtt, 0, sizeof(mRtt));
+    mBlocks = 0;
+    mRttMin = 0;
+    mRttMax = 0;
+    mRttSum = 0;
+    mSerialCalls = 0;
+    mRetries = 0;
+    mPaddingBytes = 0;
+    for (int i = 0; i < STATS_UART_ERROR_COUNT; ++i)
+        mUartErrors[i] = 0;
+
+    if (spans.empty())
+        return;
+
+    chrono::steady_clock::time_point first = spans[0].start;
+    chrono::steady_clock::time_point last = spans[0].start + spans[0].duration;
+    // Reads made for verification are not counted as transfer
+    vector<const timeline_span_t *> verify;
+
+    for (const timeline_span_t & s : spans) {
+        if (s.start < first)
+            first = s.start;
+        if (s.start + s.duration > last)
+            last = s.start + s.duration;
+        if (!strcmp(s.name, "verify"))
+            verify.push_back(&s);
+    }
+    mWall = seconds(last - first);
+
+    for (const timeline_span_t & s : spans) {
+        double d = seconds(s.duration);
+
+        if (s.instant) {
+            if (!strcmp(s.category, "retry"))
+                mRetries++;
+            else if (!strcmp(s.name, "padding"))
+                mPaddingBytes += s.bytes;
+            for (int i = 0; !strcmp(s.category, "uart") && (i < STATS_UART_ERROR_COUNT); ++i) {
+                if (!strcmp(s.name, uartErrorNames[i]))
+                    mUartErrors[i] += s.bytes;
+            }
+        } else if (!strcmp(s.category, "serial")) {
+            mSerialCalls++;
+            if (!strcmp(s.name, "open"))
+                mPhases[STATS_OPEN] += d;
+        } else if (!strcmp(s.name, "connect")) {
+            mPhases[STATS_BOOTSTRAP] += d;
+        } else if (!strcmp(s.name, "identify")) {
+            mPhases[STATS_IDENT] += d;
+        } else if (!strcmp(s.name, "stage 2 upload")) {
+            mPhases[STATS_UPLOAD] += d;
+        } else if (!strcmp(s.name, "erase blocks") || !strcmp(s.name, "erase chip")) {
+            mPhases[STATS_ERASE] += d;
+        } else if (!strcmp(s.name, "verify")) {
+            mPhases[STATS_VERIFY] += d;
+        } else if (!strcmp(s.name, "read memory") || !strcmp(s.name, "write memory")) {
+            mPayloadBytes += s.bytes;
+            mPayloadTime += d;
+            bool verifying = false;
+            for (const timeline_span_t * v : verify) {
+                if ((v->thread == s.thread) && (v->start <= s.start)
+                    && (v->start + v->duration >= s.start + s.duration))
+                    verifying = true;
+            }
+            if (!verifying)
+                mPhases[STATS_TRANSFER] += d;
+        } else if (!strcmp(s.name, "block")) {
+            double ms = d * 1000;
+            int b = 0;
+            while ((b < STATS_RTT_BUCKET_COUNT - 1) && (ms >= rttBounds[b]))
+                b++;
+            mRtt[b]++;
+            if ((mBlocks == 0) || (ms < mRttMin))
+                mRttMin = ms;
+            if (ms > mRttMax)
+                mRttMax = ms;
+            mRttSum += ms;
+            mBlocks++;
+        }
+    }
+}
+
+double
+CStats::getPayloadRate() const
+{
+    return (mPayloadTime > 0) ? mPayloadBytes / mPayloadTime : 0;
+}
+
+void
+CStats::print() const
+{
+    ostringstream os;
+
+    os << fixed << setprecision(3);
+    os << "Statistics:" << std::endl;
+    os << "  Wall time                " << mWall << " s" << std::endl;
+    for (int i = 0; i < STATS_PHASE_COUNT; ++i)
+        os << "    " << left << setw(22) << phaseNames[i] << mPhases[i] << " s" << std::endl;
+    os << setprecision(0);
+    os << "  Payload                  " << mPayloadBytes << " B in " << setprecision(3) << mPayloadTime
+       << " s, " << setprecision(0) << getPayloadRate() << " B/s, line rate " << mLineRate << " B/s ("
+       << setprecision(1) << (100.0 * getPayloadRate() / mLineRate) << " %)" << std::endl;
+    os << setprecision(3);
+    os << "  Block round trip         " << mBlocks << " blocks";
+    if (mBlocks > 0)
+        os << ", min " << mRttMin << " ms, avg " << (mRttSum / mBlocks) << " ms, max " << mRttMax << " ms";
+    os << std::endl;
+    for (int i = 0; i < STATS_RTT_BUCKET_COUNT; ++i) {
+        ostringstream b;
+        if (i < STATS_RTT_BUCKET_COUNT - 1)
+            b << "< " << rttBounds[i] << " ms";
+        else
+            b << ">= " << rttBounds[i - 1] << " ms";
+        os << "    " << left << setw(22) << b.str() << mRtt[i] << std::endl;
+    }
+    os << "  Serial port calls        " << mSerialCalls << std::endl;
+    os << "  Retries                  " << mRetries << std::endl;
+    os << "  Padding bytes sent       " << mPaddingBytes << std::endl;
+    os << "  Host UART errors        ";
+    for (int i = 0; i < STATS_UART_ERROR_COUNT; ++i)
+        os << ((i == 0) ? " " : ", ") << uartErrorNames[i] << " " << mUartErrors[i];
+    CLogger::message(os.str());
+}
+
+bool
+CStats::save(const string & fileName) const
+{
+    FILE *f = fopen(fileName.c_str(), "w");
+    if (f == NULL)
+        return false;
+
+    fprintf(f, "{\n  \"wallSeconds\": %.6f,\n  \"phaseSeconds\": {", mWall);
+    for (int i = 0; i < STATS_PHASE_COUNT; ++i)
+        fprintf(f, "%s\"%s\": %.6f", (i == 0) ? "" : ", ", phaseNames[i], mPhases[i]);
+    fprintf(f, "},\n  \"payloadBytes\": %llu,\n  \"payloadSeconds\": %.6f,\n",
+            (unsigned long long) mPayloadBytes, mPayloadTime);
+    fprintf(f, "  \"payloadBytesPerSecond\": %.0f,\n  \"lineBytesPerSecond\": %u,\n",
+            getPayloadRate(), mLineRate);
+    fprintf(f, "  \"blockRoundTrip\": {\"count\": %u, \"minMs\": %.3f, \"avgMs\": %.3f, \"maxMs\": %.3f,\n",
+            mBlocks, mRttMin, (mBlocks > 0) ? mRttSum / mBlocks : 0, mRttMax);
+    fprintf(f, "    \"histogram\": [");
+    for (int i = 0; i < STATS_RTT_BUCKET_COUNT; ++i) {
+        if (i < STATS_RTT_BUCKET_COUNT - 1)
+            fprintf(f, "%s{\"belowMs\": %u, \"count\": %u}", (i == 0) ? "" : ", ", rttBounds[i], mRtt[i]);
+        else
+            fprintf(f, ", {\"belowMs\": null, \"count\": %u}", mRtt[i]);
+    }
+    fprintf(f, "]},\n  \"serialCalls\": %u,\n  \"retries\": %u,\n  \"paddingBytes\": %llu,\n",
+            mSerialCalls, mRetries, (unsigned long long) mPaddingBytes);
+    fprintf(f, "  \"uartErrors\": {");
+    for (int i = 0; i < STATS_UART_ERROR_COUNT; ++i)
+        fprintf(f, "%s\"%s\": %llu", (i == 0) ? "" : ", ", uartErrorNames[i],
+                (unsigned long long) mUartErrors[i]);
+    fprintf(f, "}\n}\n");
+
+    bool failed = ferror(f);
+    return !(fclose(f) || failed);
+}
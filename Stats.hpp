@@ -0,0 +1,69 @@
+#ifndef STATS_HPP
+#define STATS_HPP 1
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Timeline.hpp"
+
+using std::string;
+using std::vector;
+
+// Phases of operations summarized by statistics
+typedef enum {
+    STATS_OPEN,
+    STATS_BOOTSTRAP,
+    STATS_IDENT,
+    STATS_UPLOAD,
+    STATS_ERASE,
+    STATS_TRANSFER,
+    STATS_VERIFY,
+    STATS_PHASE_COUNT
+} stats_phase_t;
+
+// Upper bounds of block round trip histogram buckets, the last bucket
+// is unbounded
+#define STATS_RTT_BUCKETS { 1, 2, 5, 10, 20, 50, 100, 200, 500, 1000, 2000 } // ms
+#define STATS_RTT_BUCKET_COUNT 12
+
+// Kinds of receive errors counted by the host UART driver
+#define STATS_UART_ERROR_COUNT 5
+
+// Summary of performance of an operation computed from the timeline
+class CStats {
+private:
+    static bool mPrint;
+    static string mJsonFileName;
+    static uint32_t mLineRate;
+
+    double mWall;
+    double mPhases[STATS_PHASE_COUNT];
+    uint64_t mPayloadBytes;
+    double mPayloadTime;
+    unsigned int mRtt[STATS_RTT_BUCKET_COUNT];
+    unsigned int mBlocks;
+    double mRttMin;
+    double mRttMax;
+    double mRttSum;
+    unsigned int mSerialCalls;
+    unsigned int mRetries;
+    uint64_t mPaddingBytes;
+    uint64_t mUartErrors[STATS_UART_ERROR_COUNT];
+
+    CStats(const vector<timeline_span_t> & spans);
+    double getPayloadRate() const;
+    void print() const;
+    bool save(const string & fileName) const;
+
+public:
+    // Speed of the serial line in Bd, "0" is the default speed
+    static void enable(bool print, const string & jsonFileName, const string & speed);
+    static bool isEnabled();
+    // Print and save summary of the timeline collected so far. Returns
+    // false when the JSON file cannot be written.
+    static bool report();
+    static const string & getJsonFileName();
+};
+
+#endif
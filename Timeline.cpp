@@ -0,0 +1,104 @@
+#include "Timeline.hpp"
+
+#include <cstdio>
+
+using std::lock_guard;
+using std::mutex;
+
+bool CTimeline::mEnabled = false;
+string CTimeline::mFileName;
+chrono::steady_clock::time_point CTimeline::mStart;
+mutex CTimeline::mMutex;
+vector<timeline_span_t> CTimeline::mSpans;
+int CTimeline::mThreads = 0;
+thread_local int CTimeline::mThread = 0;
+
+void
+CTimeline::enable()
+{
+    if (mEnabled)
+        return;
+    mStart = chrono::steady_clock::now();
+    mSpans.reserve(4096);
+    mEnabled = true;
+}
+
+void
+CTimeline::setFileName(const string & fileName)
+{
+    mFileName = fileName;
+}
+
+const string &
+CTimeline::getFileName()
+{
+    return mFileName;
+}
+
+void
+CTimeline::add(const char *name, const char *category, chrono::steady_clock::time_point start,
+               int64_t bytes)
+{
+    chrono::steady_clock::time_point end = chrono::steady_clock::now();
+    lock_guard<mutex> lock(mMutex);
+
+    // Threads are numbered in order of their first span
+    if (mThread == 0)
+        mThread = ++mThreads;
+    timeline_span_t s = { name, category, start, end - start, bytes, mThread, false };
+    mSpans.push_back(s);
+}
+
+void
+CTimeline::mark(const char *name, const char *category, int64_t bytes)
+{
+    if (!mEnabled)
+        return;
+
+    chrono::steady_clock::time_point now = chrono::steady_clock::now();
+    lock_guard<mutex> lock(mMutex);
+
+    if (mThread == 0)
+        mThread = ++mThreads;
+    timeline_span_t s = { name, category, now, chrono::steady_clock::duration(0), bytes, mThread, true };
+    mSpans.push_back(s);
+}
+
+vector<timeline_span_t>
+CTimeline::getSpans()
+{
+    lock_guard<mutex> lock(mMutex);
+    return mSpans;
+}
+
+bool
+CTimeline::save()
+{
+    if (!mEnabled || mFileName.empty())
+        return true;
+
+    FILE *f = fopen(mFileName.c_str(), "w");
+    if (f == NULL)
+        return false;
+
+    lock_guard<mutex> lock(mMutex);
+    fprintf(f, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+    for (size_t i = 0; i < mSpans.size(); ++i) {
+        const timeline_span_t & s = mSpans[i];
+        double ts = chrono::duration_cast<chrono::nanoseconds>(s.start - mStart).count() / 1000.0;
+        double dur = chrono::duration_cast<chrono::nanoseconds>(s.duration).count() / 1000.0;
+        fprintf(f, "%s\n{\"name\":\"%s\",\"cat\":\"%s\",\"ts\":%.3f,\"pid\":1,\"tid\":%d",
+                (i == 0) ? "" : ",", s.name, s.category, ts, s.thread);
+        if (s.instant)
+            fprintf(f, ",\"ph\":\"i\",\"s\":\"t\"");
+        else
+            fprintf(f, ",\"ph\":\"X\",\"dur\":%.3f", dur);
+        if (s.bytes >= 0)
+            fprintf(f, ",\"args\":{\"bytes\":%lld}", (long long) s.bytes);
+        fprintf(f, "}");
+    }
+    fprintf(f, "\n]}\n");
+
+    bool failed = ferror(f);
+    return !(fclose(f) || failed);
+}
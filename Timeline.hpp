@@ -0,0 +1,75 @@
+#ifndef TIMELINE_HPP
+#define TIMELINE_HPP 1
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <chrono>
+
+using std::string;
+using std::vector;
+namespace chrono = std::chrono;
+
+// Span of time spent in a phase of an operation. Name and category are
+// string literals, nothing is formatted until the timeline is saved.
+typedef struct {
+    const char *name;
+    const char *category;
+    chrono::steady_clock::time_point start;
+    chrono::steady_clock::duration duration;
+    int64_t bytes;      // -1 when no data are transferred
+    int thread;
+    bool instant;       // Event without duration, e.g. a retry
+} timeline_span_t;
+
+// Spans collected during the run, saved as Chrome trace event JSON which
+// can be opened in Perfetto or chrome://tracing. Spans are also collected
+// without a file to be summarized by statistics.
+class CTimeline {
+private:
+    static bool mEnabled;
+    static string mFileName;
+    static chrono::steady_clock::time_point mStart;
+    static std::mutex mMutex;
+    static vector<timeline_span_t> mSpans;
+    static int mThreads;
+    static thread_local int mThread;
+public:
+    static void enable();
+    static void setFileName(const string & fileName);
+    static bool isEnabled() { return mEnabled; }
+    static void add(const char *name, const char *category, chrono::steady_clock::time_point start,
+                    int64_t bytes);
+    static void mark(const char *name, const char *category, int64_t bytes = -1);
+    static vector<timeline_span_t> getSpans();
+    // Returns false when the file cannot be written
+    static bool save();
+    static const string & getFileName();
+};
+
+// Span measured from construction to destruction, costs only a test of
+// a flag when the timeline is not enabled
+class CTimelineSpan {
+private:
+    const char *mName;
+    const char *mCategory;
+    chrono::steady_clock::time_point mStart;
+    int64_t mBytes;
+    bool mActive;
+public:
+    CTimelineSpan(const char *name, const char *category, int64_t bytes = -1)
+        : mName(name), mCategory(category), mBytes(bytes), mActive(CTimeline::isEnabled())
+    {
+        if (mActive)
+            mStart = chrono::steady_clock::now();
+    }
+    ~CTimelineSpan()
+    {
+        if (mActive)
+            CTimeline::add(mName, mCategory, mStart, mBytes);
+    }
+    void setBytes(int64_t bytes) { mBytes = bytes; }
+};
+
+#endif
@@ -1,4 +1,5 @@
 #include <sstream>
+#include <iomanip>
 #include <memory>
 #include "ExitCodes.hpp"
 #include "UserConfig.hpp"
@@ -18,6 +19,10 @@ using std::noskipws;
 #define OPERATION_HELP     "help"
 #define OPERATION_VERSION  "version"
 #define OPERATION_IDENT    "ident"
+#define OPERATION_STATION  "station"
+#define OPERATION_VERIFY   "verify"
+#define OPERATION_BLANK    "blank"
+#define OPERATION_PLAN     "plan"
 
 
 // Common options
@@ -26,11 +31,27 @@ using std::noskipws;
 #define OPTION_SERIAL_SPEED    "-s"
 #define OPTION_FREQUENCY       "-f"
 #define OPTION_PRINT_PROGRESS  "-g"
+#define OPTION_RESET_SEQUENCE  "--reset-seq"
+#define OPTION_PIPELINE        "--pipeline"
+#define OPTION_RECORD          "--record"
+#define OPTION_REPLAY_TIMED    "--replay-timed"
+#define OPTION_TIMELINE        "--timeline"
+#define OPTION_STATS           "--stats"
+#define OPTION_STATS_JSON      "--stats-json"
+#define OPTION_PATCH           "--patch"
+#define OPTION_ABORT_AFTER     "--abort-after"
+#define OPTION_REPAIR          "--repair"
+#define OPTION_AVOID_ERASE     "--avoid-erase"
+#define OPTION_SKIP_BLANK      "--skip-blank"
 // Options specific for an operation
 #define OPTION_B            "-b"
 #define OPTION_C            "-c"
+#define OPTION_D            "-d"
 #define OPTION_E            "-e"
+#define OPTION_M            "-m"
 #define OPTION_N            "-n"
+#define OPTION_Q            "-q"
+#define OPTION_PROFILE      "--profile"
 
 
 CUserConfig::CUserConfig(int argc, char **argv)
@@ -42,7 +63,10 @@ CUserConfig::CUserConfig(int argc, char **argv)
     mHelp = false;
     mVersion = false;
     mIdent = false;
+    mIdentQuick = false;
     mErase = false;
+    mEraseSkipBlank = false;
+    mBlank = false;
     mRead = false;
     mReadOutputFilename = "";
     mReadLength = -1;
@@ -50,8 +74,26 @@ CUserConfig::CUserConfig(int argc, char **argv)
     mWriteInputFilename = "";
     mWriteEraseWholeMemory = false;
     mWriteCheckByRead = false;
+    mWriteLength = -1;
+    mVerifyAbortAfter = 0;
+    mWriteRepairAttempts = 0;
+    mWriteAvoidErase = false;
+    mVerify = false;
+    mStation = false;
+    mStationDirectory = "/dev";
+    mStationPattern = "";
+    mStationCount = 0;
+    mPlan = false;
+    mPlanMcuName = "";
+    mPlanProfileFilename = "";
     mMcuFrequency = 0;
     mPrintProgress = false;
+    mPipeline = false;
+    mRecordFilename = "";
+    mReplayTimed = false;
+    mTimelineFilename = "";
+    mStats = false;
+    mStatsFilename = "";
 
     vector<char *> args;
 
@@ -97,6 +139,27 @@ CUserConfig::parseCommandLine(vector<char *> & args)
         } else if (!a.compare(OPTION_PRINT_PROGRESS)) {
     	    mPrintProgress = true;
             processed = true;
+        } else if (!a.compare(OPTION_PIPELINE)) {
+    	    mPipeline = true;
+            processed = true;
+        } else if (!a.compare(OPTION_RECORD)) {
+            mRecordFilename = getArgument(it, args.end());
+            processed = true;
+            with_argument = true;
+        } else if (!a.compare(OPTION_REPLAY_TIMED)) {
+            mReplayTimed = true;
+            processed = true;
+        } else if (!a.compare(OPTION_TIMELINE)) {
+            mTimelineFilename = getArgument(it, args.end());
+            processed = true;
+            with_argument = true;
+        } else if (!a.compare(OPTION_STATS)) {
+            mStats = true;
+            processed = true;
+        } else if (!a.compare(OPTION_STATS_JSON)) {
+            mStatsFilename = getArgument(it, args.end());
+            processed = true;
+            with_argument = true;
     	} else if (!a.compare(OPTION_FREQUENCY)) {
             istringstream is(getArgument(it, args.end()));
             string s = is.str();
@@ -112,7 +175,11 @@ CUserConfig::parseCommandLine(vector<char *> & args)
             mMcuFrequency = f;
             processed = true;
             with_argument = true;
-    	}
+    	} else if (!a.compare(OPTION_RESET_SEQUENCE)) {
+            mResetSequence.reset(new CResetSequence(getArgument(it, args.end())));
+            processed = true;
+            with_argument = true;
+        }
         
         if (processed) {
             it = args.erase(it);
@@ -134,22 +201,53 @@ CUserConfig::parseCommandLine(vector<char *> & args)
         } else if (!a.compare(OPERATION_ERASE)) {
             mErase = true;
             parseEraseArguments(++it, args.end());
+        } else if (!a.compare(OPERATION_BLANK)) {
+            mBlank = true;
+            parseBlankArguments(++it, args.end());
         } else if (!a.compare(OPERATION_READ)) {
             mRead = true;
             parseReadArguments(++it, args.end());
         } else if (!a.compare(OPERATION_WRITE)) {
             mWrite = true;
             parseWriteArguments(++it, args.end());
+        } else if (!a.compare(OPERATION_VERIFY)) {
+            mVerify = true;
+            parseVerifyArguments(++it, args.end());
+        } else if (!a.compare(OPERATION_STATION)) {
+            mStation = true;
+            parseStationArguments(++it, args.end());
+        } else if (!a.compare(OPERATION_PLAN)) {
+            mPlan = true;
+            parsePlanArguments(++it, args.end());
         } else if (!a.compare(OPERATION_HELP)) {
             mHelp = true;
         } else if (!a.compare(OPERATION_VERSION)) {
             mVersion = true;
         } else if (!a.compare(OPERATION_IDENT)) {
             mIdent = true;
+            parseIdentArguments(++it, args.end());
         } else {
             CLogger::error("Unknown operation requested: " + a, EXIT_USER_CONFIG);
         }
     }
+    // Boards of a station are served concurrently, one trace cannot hold them
+    if (mStation && !mRecordFilename.empty())
+        CLogger::error("Option " OPTION_RECORD " cannot be used with station operation", EXIT_USER_CONFIG);
+}
+
+void
+CUserConfig::parseIdentArguments(vector<char *>::const_iterator args, 
+                                 vector<char *>::const_iterator end)
+{
+    while (args != end) {
+    	string a = *args;
+        if (!a.compare(OPTION_Q)) {
+            mIdentQuick = true;
+            ++args;
+    	} else {
+            CLogger::error("Unknown argument '" + a + "' for ident operation", EXIT_USER_CONFIG);
+        }
+    }
 }
 
 void
@@ -159,32 +257,12 @@ CUserConfig::parseEraseArguments(vector<char *>::const_iterator args,
     while (args != end) {
     	string a = *args;
         if (!a.compare(OPTION_B)) {
-            // Prepend comma for unified parsing
-            istringstream is("," + getArgument(args, end));
-            // Parse block numbers list
-            bool e = false;
-            for (;;) {
-        	// Get comma
-        	int c = is.get();
-        	if (is.eof()) {
-        	    break;
-        	} else if (c != ',') {
-        	    e = true;
-        	    break;
-        	}
-        	// Get number
-        	int n;
-        	is >> n;
-        	if (is.fail()) {
-        	    e = true;
-        	    break;
-        	}
-        	mEraseBlockList.push_back(n);
-            }
-            if (e || mEraseBlockList.size() == 0)
-        	CLogger::error("Argument for -b option must be in format N[,N]...", EXIT_USER_CONFIG);
+            parseBlockList(getArgument(args, end), mEraseBlockList);
             ++args;
             ++args;
+        } else if (!a.compare(OPTION_SKIP_BLANK)) {
+            mEraseSkipBlank = true;
+            ++args;
     	} else {
             string s = *args;
             CLogger::error("Unknown argument '" + s + "' for erase operation", EXIT_USER_CONFIG);
@@ -192,6 +270,51 @@ CUserConfig::parseEraseArguments(vector<char *>::const_iterator args,
     }
 }
 
+void
+CUserConfig::parseBlankArguments(vector<char *>::const_iterator args, 
+                                 vector<char *>::const_iterator end)
+{
+    while (args != end) {
+    	string a = *args;
+        if (!a.compare(OPTION_B)) {
+            parseBlockList(getArgument(args, end), mBlankBlockList);
+            ++args;
+            ++args;
+    	} else {
+            CLogger::error("Unknown argument '" + a + "' for blank operation", EXIT_USER_CONFIG);
+        }
+    }
+}
+
+void
+CUserConfig::parseBlockList(const string & arg, list<unsigned int> & blocks)
+{
+    // Prepend comma for unified parsing
+    istringstream is("," + arg);
+    // Parse block numbers list
+    bool e = false;
+    for (;;) {
+        // Get comma
+        int c = is.get();
+        if (is.eof()) {
+            break;
+        } else if (c != ',') {
+            e = true;
+            break;
+        }
+        // Get number
+        int n;
+        is >> n;
+        if (is.fail()) {
+            e = true;
+            break;
+        }
+        blocks.push_back(n);
+    }
+    if (e || blocks.size() == 0)
+        CLogger::error("Argument for -b option must be in format N[,N]...", EXIT_USER_CONFIG);
+}
+
 void
 CUserConfig::parseReadArguments(vector<char *>::const_iterator args, 
                                 vector<char *>::const_iterator end)
@@ -233,26 +356,214 @@ CUserConfig::parseWriteArguments(vector<char *>::const_iterator args,
 {
     while (args != end) {
     	string a = *args;
-        if (!a.compare(OPTION_E)) {
-            mWriteEraseWholeMemory = true;
+        if (parseWriteOption(args, end))
+            continue;
+        if (!a.compare(OPTION_N)) {
+            istringstream n(getArgument(args, end));
+            string s = n.str();
+            n >> noskipws >> mWriteLength;
+            if (n.fail() || (mWriteLength < 1) || (n.peek() != EOF)) {
+                ostringstream os;
+                os << "Argument for -n option '" << s << "' is not a positive number";
+        	CLogger::error(os.str(), EXIT_USER_CONFIG);
+            }
             ++args;
-        } else if (!a.compare(OPTION_C)) {
-            mWriteCheckByRead = true;
             ++args;
     	} else {
-            // First occurence of this is the name of output file
-            if (mWriteInputFilename.length() == 0) {
-        	mWriteInputFilename = a;
+            // All other arguments are input files
+            addWriteInput(a);
+            ++args;
+    	}
+    }
+    // Must have at least filename where to write output
+    if (mWriteInputFilename.length() == 0)
+        CLogger::error("Missing input filename for write operation", EXIT_USER_CONFIG);
+    // Length of other files is known
+    if ((mWriteLength != -1) && ((mWriteInputs.size() != 1) || mWriteInputFilename.compare("-")))
+        CLogger::error("Option -n of write operation requires standard input '-' as the only FILE", EXIT_USER_CONFIG);
+    checkAvoidErase();
+}
+
+bool
+CUserConfig::parseWriteOption(vector<char *>::const_iterator & args,
+                              vector<char *>::const_iterator end)
+{
+    string a = *args;
+    if (!a.compare(OPTION_E)) {
+        mWriteEraseWholeMemory = true;
+        ++args;
+    } else if (!a.compare(OPTION_C)) {
+        mWriteCheckByRead = true;
+        ++args;
+    } else if (!a.compare(OPTION_PATCH)) {
+        mWritePatches.push_back(CPatch(getArgument(args, end)));
+        ++args;
+        ++args;
+    } else if (!a.compare(OPTION_ABORT_AFTER)) {
+        mVerifyAbortAfter = parseCount(a, getArgument(args, end));
+        ++args;
+        ++args;
+    } else if (!a.compare(OPTION_REPAIR)) {
+        // Repair is based on the check
+        mWriteRepairAttempts = parseCount(a, getArgument(args, end));
+        mWriteCheckByRead = true;
+        ++args;
+        ++args;
+    } else if (!a.compare(OPTION_AVOID_ERASE)) {
+        mWriteAvoidErase = true;
+        ++args;
+    } else if (!a.compare(OPTION_SKIP_BLANK)) {
+        mEraseSkipBlank = true;
+        ++args;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+void
+CUserConfig::addWriteInput(const string & arg)
+{
+    write_input_t in;
+
+    // Unknown options are not taken for file names, use ./-NAME for those
+    if ((arg.length() > 1) && (arg[0] == '-'))
+        CLogger::error("Unknown argument '" + arg + "'", EXIT_USER_CONFIG);
+
+    in.fname = arg;
+    in.hasAddress = false;
+    in.address = 0;
+
+    // Address follows the last '@' when it is a number, otherwise '@' is
+    // a part of file name
+    string::size_type d = arg.rfind('@');
+    if ((d != string::npos) && (d > 0) && (d + 1 < arg.length())) {
+        string s = arg.substr(d + 1);
+        istringstream n(s);
+        unsigned long address;
+        n >> std::setbase(0) >> noskipws >> address;
+        if (!n.fail() && (n.peek() == EOF) && (s[0] != '-') && (s[0] != '+')) {
+            if (address > 0xFFFFFFFFul) {
+                ostringstream os;
+                os << "Address '" << s << "' of input file is out of 32-bit range";
+                CLogger::error(os.str(), EXIT_USER_CONFIG);
+            }
+            in.fname = arg.substr(0, d);
+            in.hasAddress = true;
+            in.address = address;
+        }
+    }
+
+    for (list<write_input_t>::const_iterator it = mWriteInputs.begin(); it != mWriteInputs.end(); ++it) {
+        if (!it->fname.compare("-") && !in.fname.compare("-"))
+            CLogger::error("Standard input '-' can be given only once", EXIT_USER_CONFIG);
+    }
+
+    if (mWriteInputs.empty())
+        mWriteInputFilename = in.fname;
+    mWriteInputs.push_back(in);
+}
+
+void
+CUserConfig::parseVerifyArguments(vector<char *>::const_iterator args, 
+                                  vector<char *>::const_iterator end)
+{
+    while (args != end) {
+    	string a = *args;
+        if (!a.compare(OPTION_ABORT_AFTER)) {
+            mVerifyAbortAfter = parseCount(a, getArgument(args, end));
+            ++args;
+            ++args;
+    	} else {
+            // All other arguments are reference files
+            addWriteInput(a);
+            ++args;
+    	}
+    }
+    if (mWriteInputFilename.length() == 0)
+        CLogger::error("Missing reference filename for verify operation", EXIT_USER_CONFIG);
+}
+
+void
+CUserConfig::parseStationArguments(vector<char *>::const_iterator args, 
+                                   vector<char *>::const_iterator end)
+{
+    while (args != end) {
+    	string a = *args;
+        if (parseWriteOption(args, end))
+            continue;
+        if (!a.compare(OPTION_D)) {
+            mStationDirectory = getArgument(args, end);
+            ++args;
+            ++args;
+        } else if (!a.compare(OPTION_N)) {
+            istringstream n(getArgument(args, end));
+            string s = n.str();
+            n >> noskipws >> mStationCount;
+            if (n.fail() || (mStationCount < 0) || (n.peek() != EOF)) {
+                ostringstream os;
+                os << "Argument for -n option '" << s << "' is not 0 or a positive number";
+        	CLogger::error(os.str(), EXIT_USER_CONFIG);
+            }
+            ++args;
+            ++args;
+    	} else {
+            // The first positional argument is the device name pattern,
+            // following ones are input files
+            if (mStationPattern.length() == 0) {
+                mStationPattern = a;
                 ++args;
             } else {
-        	string s = *args;
-        	CLogger::error("Unknown argument '" + s + "' for write operation", EXIT_USER_CONFIG);
+                addWriteInput(a);
+                ++args;
             }
     	}
     }
-    // Must have at least filename where to write output
+    if (mStationPattern.length() == 0)
+        CLogger::error("Missing device name pattern for station operation", EXIT_USER_CONFIG);
     if (mWriteInputFilename.length() == 0)
-        CLogger::error("Missing input filename for write operation", EXIT_USER_CONFIG);
+        CLogger::error("Missing input filename for station operation", EXIT_USER_CONFIG);
+    checkAvoidErase();
+}
+
+void
+CUserConfig::parsePlanArguments(vector<char *>::const_iterator args,
+                                vector<char *>::const_iterator end)
+{
+    while (args != end) {
+    	string a = *args;
+        if (!a.compare(OPTION_M)) {
+            mPlanMcuName = getArgument(args, end);
+            ++args;
+            ++args;
+        } else if (!a.compare(OPTION_E)) {
+            mWriteEraseWholeMemory = true;
+            ++args;
+        } else if (!a.compare(OPTION_C)) {
+            mWriteCheckByRead = true;
+            ++args;
+        } else if (!a.compare(OPTION_PROFILE)) {
+            mPlanProfileFilename = getArgument(args, end);
+            ++args;
+            ++args;
+    	} else {
+            // All other arguments are input files
+            addWriteInput(a);
+            ++args;
+    	}
+    }
+    if (mWriteInputFilename.length() == 0)
+        CLogger::error("Missing input filename for plan operation", EXIT_USER_CONFIG);
+}
+
+void
+CUserConfig::checkAvoidErase()
+{
+    // Current content is compared with data before blocks are erased
+    if (mWriteAvoidErase && mWriteEraseWholeMemory)
+        CLogger::error("Option --avoid-erase can not be used with -e", EXIT_USER_CONFIG);
+    if (mWriteAvoidErase && (mWriteLength != -1))
+        CLogger::error("Option --avoid-erase can not be used with -n", EXIT_USER_CONFIG);
 }
 
 string
@@ -278,6 +589,24 @@ CUserConfig::getEraseBlockList()
     return mEraseBlockList;
 }
 
+bool
+CUserConfig::getEraseSkipBlank()
+{
+    return mEraseSkipBlank;
+}
+
+bool
+CUserConfig::isBlankSet()
+{
+    return mBlank;
+}
+
+list<unsigned int>
+CUserConfig::getBlankBlockList()
+{
+    return mBlankBlockList;
+}
+
 bool
 CUserConfig::isReadSet()
 {
@@ -302,6 +631,42 @@ CUserConfig::isPrintProgressSet()
     return mPrintProgress;
 }
 
+bool
+CUserConfig::isPipelineSet()
+{
+    return mPipeline;
+}
+
+string &
+CUserConfig::getRecordFilename()
+{
+    return mRecordFilename;
+}
+
+bool
+CUserConfig::isReplayTimedSet()
+{
+    return mReplayTimed;
+}
+
+string &
+CUserConfig::getTimelineFilename()
+{
+    return mTimelineFilename;
+}
+
+bool
+CUserConfig::isStatsSet()
+{
+    return mStats;
+}
+
+string &
+CUserConfig::getStatsFilename()
+{
+    return mStatsFilename;
+}
+
 bool
 CUserConfig::isHelpSet()
 {
@@ -320,6 +685,12 @@ CUserConfig::isIdentSet()
     return mIdent;
 }
 
+bool
+CUserConfig::getIdentQuick()
+{
+    return mIdentQuick;
+}
+
 string &
 CUserConfig::getSerialPortName()
 {
@@ -350,6 +721,57 @@ CUserConfig::getReadLength()
     return mReadLength;
 }
 
+const list<write_input_t> &
+CUserConfig::getWriteInputs()
+{
+    return mWriteInputs;
+}
+
+int
+CUserConfig::parseCount(const string & option, const string & arg)
+{
+    istringstream n(arg);
+    int count;
+
+    n >> noskipws >> count;
+    if (n.fail() || (count < 0) || (n.peek() != EOF)) {
+        ostringstream os;
+        os << "Argument for " << option << " option '" << arg << "' is not 0 or a positive number";
+        CLogger::error(os.str(), EXIT_USER_CONFIG);
+    }
+    return count;
+}
+
+int
+CUserConfig::getWriteRepairAttempts()
+{
+    return mWriteRepairAttempts;
+}
+
+bool
+CUserConfig::getWriteAvoidErase()
+{
+    return mWriteAvoidErase;
+}
+
+int
+CUserConfig::getVerifyAbortAfter()
+{
+    return mVerifyAbortAfter;
+}
+
+const vector<CPatch> &
+CUserConfig::getWritePatches()
+{
+    return mWritePatches;
+}
+
+int
+CUserConfig::getWriteLength()
+{
+    return mWriteLength;
+}
+
 bool
 CUserConfig::getWriteEraseWholeMemory()
 {
@@ -362,6 +784,54 @@ CUserConfig::getWriteCheckByRead()
     return mWriteCheckByRead;
 }
 
+bool
+CUserConfig::isVerifySet()
+{
+    return mVerify;
+}
+
+bool
+CUserConfig::isPlanSet()
+{
+    return mPlan;
+}
+
+string &
+CUserConfig::getPlanMcuName()
+{
+    return mPlanMcuName;
+}
+
+string &
+CUserConfig::getPlanProfileFilename()
+{
+    return mPlanProfileFilename;
+}
+
+bool
+CUserConfig::isStationSet()
+{
+    return mStation;
+}
+
+string &
+CUserConfig::getStationDirectory()
+{
+    return mStationDirectory;
+}
+
+string &
+CUserConfig::getStationPattern()
+{
+    return mStationPattern;
+}
+
+int
+CUserConfig::getStationCount()
+{
+    return mStationCount;
+}
+
 bool
 CUserConfig::isSpeedsSet()
 {
@@ -373,3 +843,9 @@ CUserConfig::getMcuFrequency()
 {
     return mMcuFrequency;
 }
+
+const CResetSequence *
+CUserConfig::getResetSequence()
+{
+    return mResetSequence.get();
+}
@@ -4,10 +4,22 @@
 #include <iostream>
 #include <list>
 #include <vector>
+#include <memory>
+
+#include "ResetSequence.hpp"
+#include "Patch.hpp"
 
 using std::string;
 using std::list;
 using std::vector;
+using std::unique_ptr;
+
+// Input file of write operation, raw binary data may be placed at address
+typedef struct {
+    string fname;
+    bool hasAddress;
+    uint32_t address;
+} write_input_t;
 
 class CUserConfig {
 private:
@@ -17,12 +29,24 @@ private:
     bool mHelp;
     bool mVersion;
     bool mIdent;
+    bool mIdentQuick;
     bool mSpeeds;
     float mMcuFrequency;
     bool mPrintProgress;
+    bool mPipeline;
+    string mRecordFilename;
+    bool mReplayTimed;
+    string mTimelineFilename;
+    bool mStats;
+    string mStatsFilename;
+    unique_ptr<CResetSequence> mResetSequence;
     // Erase    
     bool mErase;
     list<unsigned int> mEraseBlockList;
+    bool mEraseSkipBlank;
+    // Blank
+    bool mBlank;
+    list<unsigned int> mBlankBlockList;
     // Read
     bool mRead;
     string mReadOutputFilename;
@@ -31,13 +55,41 @@ private:
     bool   mWrite;
     bool   mWriteEraseWholeMemory;
     string mWriteInputFilename;
+    list<write_input_t> mWriteInputs;
     bool   mWriteCheckByRead;
+    int    mWriteLength;
+    vector<CPatch> mWritePatches;
+    int    mVerifyAbortAfter;
+    int    mWriteRepairAttempts;
+    bool   mWriteAvoidErase;
+    // Verify
+    bool   mVerify;
+    // Station
+    bool   mStation;
+    string mStationDirectory;
+    string mStationPattern;
+    int    mStationCount;
+    // Plan
+    bool   mPlan;
+    string mPlanMcuName;
+    string mPlanProfileFilename;
 
     string getArgument(vector<char *>::const_iterator args, vector<char *>::const_iterator end);
+    void parseIdentArguments(vector<char *>::const_iterator args, vector<char *>::const_iterator end);
     void parseEraseArguments(vector<char *>::const_iterator args, vector<char *>::const_iterator end);
+    void parseBlankArguments(vector<char *>::const_iterator args, vector<char *>::const_iterator end);
+    void parseBlockList(const string & arg, list<unsigned int> & blocks);
     void parseReadArguments(vector<char *>::const_iterator args, vector<char *>::const_iterator end);
     void parseWriteArguments(vector<char *>::const_iterator args, vector<char *>::const_iterator end);
+    // Options shared by write and station, args is moved past a recognized one
+    bool parseWriteOption(vector<char *>::const_iterator & args, vector<char *>::const_iterator end);
+    void parseVerifyArguments(vector<char *>::const_iterator args, vector<char *>::const_iterator end);
+    void parseStationArguments(vector<char *>::const_iterator args, vector<char *>::const_iterator end);
+    void parsePlanArguments(vector<char *>::const_iterator args, vector<char *>::const_iterator end);
     void parseCommandLine(vector<char *> & args);
+    void addWriteInput(const string & arg);
+    int parseCount(const string & option, const string & arg);
+    void checkAvoidErase();
     
 public:
     CUserConfig(int argc, char **argv);
@@ -49,19 +101,44 @@ public:
     bool isSpeedsSet();
     bool isVerboseModeSet();
     bool isPrintProgressSet();
+    bool isPipelineSet();
+    string & getRecordFilename();
+    bool isReplayTimedSet();
+    string & getTimelineFilename();
+    bool isStatsSet();
+    string & getStatsFilename();
     bool isHelpSet();
     bool isVersionSet();
     bool isIdentSet();
+    bool getIdentQuick();
     bool isEraseSet();
     list<unsigned int> getEraseBlockList();
+    bool getEraseSkipBlank();
+    bool isBlankSet();
+    list<unsigned int> getBlankBlockList();
     bool isReadSet();
     string & getReadOutputFname();
     bool isWriteSet();
     string & getWriteInputFname();
+    const list<write_input_t> & getWriteInputs();
     int getReadLength();
     bool getWriteEraseWholeMemory();
     bool getWriteCheckByRead();
+    int getWriteLength();
+    const vector<CPatch> & getWritePatches();
+    int getVerifyAbortAfter();
+    int getWriteRepairAttempts();
+    bool getWriteAvoidErase();
+    bool isVerifySet();
+    bool isStationSet();
+    string & getStationDirectory();
+    string & getStationPattern();
+    int getStationCount();
+    bool isPlanSet();
+    string & getPlanMcuName();
+    string & getPlanProfileFilename();
     float getMcuFrequency();
+    const CResetSequence * getResetSequence();
 };
 
 #endif
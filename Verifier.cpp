@@ -0,0 +1,172 @@
+#include "Verifier.hpp"
+#include "Logger.hpp"
+
+#include <cstring>
+#include <sstream>
+
+using std::ostringstream;
+
+// Ranges printed for one block, the rest is only counted
+#define VERIFIER_REPORT_RANGES 4
+
+CVerifier::CVerifier(CDataSource & expected, const CBlockLayout & layout, uint32_t abortAfter,
+                     const CImage * coverage)
+    : mExpected(expected), mLayout(layout), mCoverage(coverage), mAbortAfter(abortAfter), mOffset(0),
+      mMismatchCount(0), mAborted(false)
+{
+    ;
+}
+
+void
+CVerifier::addMismatch(uint32_t startAddr, uint32_t endAddr)
+{
+    mMismatchCount += endAddr - startAddr;
+    // Adjacent differences make one range
+    if (!mMismatches.empty() && (mMismatches.back().end == startAddr)) {
+        mMismatches.back().end = endAddr;
+        return;
+    }
+    CImage::range_t r;
+    r.start = startAddr;
+    r.end = endAddr;
+    mMismatches.push_back(r);
+}
+
+void
+CVerifier::addCoveredMismatch(uint32_t startAddr, uint32_t endAddr)
+{
+    if (!mCoverage) {
+        addMismatch(startAddr, endAddr);
+        return;
+    }
+    // Parts of the range within coverage data
+    CImage::const_iterator it;
+    for (it = mCoverage->findExtent(startAddr); (it != mCoverage->end()) && (it->first < endAddr); ++it) {
+        const CImage::extent_t & e = it->second;
+        uint32_t s = (e.address > startAddr) ? e.address : startAddr;
+        uint32_t t = (e.address + e.length < endAddr) ? e.address + e.length : endAddr;
+        if (s < t)
+            addMismatch(s, t);
+    }
+}
+
+void
+CVerifier::write(const uint8_t *data, uint32_t length)
+{
+    const uint8_t *e = mExpected.next(length);
+
+    // Equal blocks are the common case, memcmp() compares them with vector
+    // instructions where available
+    if (memcmp(data, e, length) != 0) {
+        uint32_t i = 0;
+        while (i < length) {
+            // Skip equal machine words
+            for ( ; i + sizeof(uint64_t) <= length; i += sizeof(uint64_t)) {
+                uint64_t x, y;
+                memcpy(&x, data + i, sizeof(x));
+                memcpy(&y, e + i, sizeof(y));
+                if (x != y)
+                    break;
+            }
+            if ((i < length) && (data[i] == e[i])) {
+                ++i;
+                continue;
+            }
+            // Run of differing bytes
+            uint32_t start = i;
+            while ((i < length) && (data[i] != e[i]))
+                ++i;
+            if (i > start)
+                addCoveredMismatch(mOffset + start, mOffset + i);
+        }
+    }
+    mOffset += length;
+
+    if ((mAbortAfter != 0) && (mMismatchCount >= mAbortAfter))
+        mAborted = true;
+}
+
+bool
+CVerifier::isAborted() const
+{
+    return mAborted;
+}
+
+bool
+CVerifier::hasMismatch() const
+{
+    return mMismatchCount != 0;
+}
+
+uint32_t
+CVerifier::getMismatchCount() const
+{
+    return mMismatchCount;
+}
+
+uint32_t
+CVerifier::getVerifiedLength() const
+{
+    return mOffset;
+}
+
+const list<CImage::range_t> &
+CVerifier::getMismatches() const
+{
+    return mMismatches;
+}
+
+list<unsigned int>
+CVerifier::getMismatchBlocks() const
+{
+    list<unsigned int> blocks;
+    list<CImage::range_t>::const_iterator it;
+
+    for (it = mMismatches.begin(); it != mMismatches.end(); ++it) {
+        unsigned int first = mLayout.findBlock(it->start);
+        unsigned int last = mLayout.findBlock(it->end - 1);
+        if (!blocks.empty() && (blocks.back() == first))
+            ++first;
+        for (unsigned int b = first; (b <= last) && (b < mLayout.getBlockCount()); ++b)
+            blocks.push_back(b);
+    }
+    return blocks;
+}
+
+void
+CVerifier::report() const
+{
+    list<unsigned int> blocks = getMismatchBlocks();
+    list<unsigned int>::const_iterator b;
+
+    for (b = blocks.begin(); b != blocks.end(); ++b) {
+        const CImage::range_t & block = mLayout.getBlock(*b);
+        uint32_t bytes = 0;
+        unsigned int ranges = 0;
+        ostringstream os;
+
+        list<CImage::range_t>::const_iterator it;
+        for (it = mMismatches.begin(); it != mMismatches.end(); ++it) {
+            // Part of the range within the block
+            uint32_t s = (it->start > block.start) ? it->start : block.start;
+            uint32_t e = (it->end < block.end) ? it->end : block.end;
+            if (s >= e)
+                continue;
+            if (ranges < VERIFIER_REPORT_RANGES)
+                os << " " << CLogger::decToHex(s) << "-" << CLogger::decToHex(e - 1);
+            bytes += e - s;
+            ++ranges;
+        }
+        if (ranges > VERIFIER_REPORT_RANGES)
+            os << " and " << (ranges - VERIFIER_REPORT_RANGES) << " more";
+
+        ostringstream msg;
+        msg << "Block " << *b << ": " << bytes << " bytes differ in " << ranges << " ranges:" << os.str();
+        CLogger::warning(msg.str());
+    }
+    if (mAborted) {
+        ostringstream os;
+        os << "Verification aborted after " << mOffset << " bytes";
+        CLogger::warning(os.str());
+    }
+}
@@ -0,0 +1,48 @@
+#ifndef VERIFIER_HPP
+#define VERIFIER_HPP 1
+
+#include "DataSink.hpp"
+#include "DataSource.hpp"
+#include "BlockLayout.hpp"
+
+#include <cstdint>
+#include <list>
+
+using std::list;
+
+// Compares memory content with expected data block by block as it is read.
+// Differences are collected as address ranges. Reading is aborted when
+// number of differing bytes reaches the threshold (0 means never).
+class CVerifier : public CDataSink {
+private:
+    CDataSource & mExpected;
+    const CBlockLayout & mLayout;
+    const CImage * mCoverage;
+    uint32_t mAbortAfter;
+    uint32_t mOffset;
+    uint32_t mMismatchCount;
+    bool mAborted;
+    list<CImage::range_t> mMismatches;
+
+    void addMismatch(uint32_t startAddr, uint32_t endAddr);
+    void addCoveredMismatch(uint32_t startAddr, uint32_t endAddr);
+
+public:
+    CVerifier(CDataSource & expected, const CBlockLayout & layout, uint32_t abortAfter,
+              const CImage * coverage = 0);
+
+    void write(const uint8_t *data, uint32_t length);
+    bool isAborted() const;
+
+    bool hasMismatch() const;
+    uint32_t getMismatchCount() const;
+    // Number of bytes compared before verification ended
+    uint32_t getVerifiedLength() const;
+    const list<CImage::range_t> & getMismatches() const;
+    // Blocks containing at least one differing byte
+    list<unsigned int> getMismatchBlocks() const;
+    // Print differing ranges grouped by blocks
+    void report() const;
+};
+
+#endif
@@ -0,0 +1,258 @@
+#include "WriteEstimate.hpp"
+#include "Mcu.hpp"
+#include "Logger.hpp"
+#include "ExitCodes.hpp"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <sstream>
+#include <iomanip>
+
+using std::cout;
+using std::endl;
+using std::setw;
+using std::left;
+using std::right;
+using std::fixed;
+using std::setprecision;
+
+// Default speed of serial port backends
+#define DEFAULT_LINE_SPEED 19200
+// Start, 8 data bits and stop bit
+#define BITS_PER_BYTE      10
+#define BLOCK_LENGTH       1024
+// Status word and position double word following each block
+#define BLOCK_STATUS_LENGTH 6
+// Turnaround of a USB serial adapter when no profile is given
+#define DEFAULT_LATENCY    0.001 // s
+
+static const char *phaseNames[ESTIMATE_PHASE_COUNT] = {
+    "bootstrap", "erase", "read back", "transfer", "verify"
+};
+
+CWriteEstimate::CWriteEstimate(IMcuSpecifics & specifics, const CWritePlan & plan, bool checkByRead,
+                               const string & speed, float mcuFrequency, bool pipelined)
+    : mSpecifics(specifics), mPlan(plan), mLatency(DEFAULT_LATENCY), mConnectTime(-1),
+      mPipelined(pipelined), mEraseCommands(0)
+{
+    unsigned long s = strtoul(speed.c_str(), NULL, 10);
+    mSpeed = (s == 0) ? DEFAULT_LINE_SPEED : s;
+    mLineRate = (double) mSpeed / BITS_PER_BYTE;
+    mConfigWords = specifics.getConfigData(mcuFrequency).size();
+    for (int i = 0; i < ESTIMATE_PHASE_COUNT; ++i)
+        mPhases[i] = estimate_traffic_t();
+
+    // Zero byte and its ack, then the loader answers identification and
+    // the result of stage 2 initialization
+    estimate_traffic_t & b = mPhases[ESTIMATE_BOOTSTRAP];
+    uint32_t length, padding;
+    CMcu::getLoaderLength(specifics, length, padding);
+    b.bytesOut = 1 + length;
+    b.bytesIn = 1 + 4 + 2;
+    b.paddingBytes = padding;
+    b.handshakes = 3;
+
+    estimate_traffic_t & e = mPhases[ESTIMATE_ERASE];
+    if (plan.getEraseWhole()) {
+        addShellCommand(e);
+        e.erasedBlocks = specifics.getBlockSizes().size();
+    } else if (!plan.getEraseBlocks().empty()) {
+        addShellCommand(e);
+        addSafeValues(e, 1, 0);
+        e.erasedBlocks = plan.getEraseBlocks().size();
+    }
+    if (e.erasedBlocks > 0) {
+        // Status of the erase
+        e.bytesIn += 2;
+        e.handshakes++;
+        mEraseCommands = 1;
+    }
+
+    if (plan.getReadBackLength() > 0)
+        addRead(mPhases[ESTIMATE_READ_BACK], plan.getReadBackLength());
+    addWrite(mPhases[ESTIMATE_TRANSFER], plan.getTransferLength());
+    if (checkByRead)
+        addRead(mPhases[ESTIMATE_VERIFY], plan.getTransferLength());
+}
+
+void
+CWriteEstimate::addSafeValues(estimate_traffic_t & t, unsigned int words, unsigned int bytes) const
+{
+    // Value is echoed, its second copy is answered by zero
+    unsigned int n = 2 * words + bytes;
+    t.bytesOut += 2 * n;
+    t.bytesIn += 2 * n;
+    t.handshakes += (mPipelined ? 1 : 2) * (words + bytes);
+}
+
+void
+CWriteEstimate::addShellCommand(estimate_traffic_t & t) const
+{
+    addSafeValues(t, mConfigWords, 1);
+}
+
+void
+CWriteEstimate::addRead(estimate_traffic_t & t, uint32_t size) const
+{
+    uint32_t r = size + (size % 2);
+    unsigned int blocks = (r + BLOCK_LENGTH - 1) / BLOCK_LENGTH;
+
+    if (size == 0)
+        return;
+    addShellCommand(t);
+    addSafeValues(t, 2, 0);
+    // Shell sends the blocks without waiting for the host
+    t.bytesIn += r + blocks * BLOCK_STATUS_LENGTH;
+    t.blocks += blocks;
+}
+
+void
+CWriteEstimate::addWrite(estimate_traffic_t & t, uint32_t size) const
+{
+    uint32_t bw = size + (size % 2);
+    unsigned int blocks = (bw + BLOCK_LENGTH - 1) / BLOCK_LENGTH;
+
+    if (size == 0)
+        return;
+    addShellCommand(t);
+    addSafeValues(t, 2, 0);
+    // Host waits for the status of each block
+    t.bytesOut += bw;
+    t.paddingBytes += bw - size;
+    t.bytesIn += blocks * BLOCK_STATUS_LENGTH;
+    t.handshakes += blocks;
+    t.blocks += blocks;
+}
+
+double
+CWriteEstimate::getReadSeconds(IMcuSpecifics & specifics, uint32_t size, const string & speed,
+                               float mcuFrequency, bool pipelined)
+{
+    CWritePlan plan(size, specifics.getBlockSizes(), specifics.getFlashSize(), false);
+    CWriteEstimate e(specifics, plan, false, speed, mcuFrequency, pipelined);
+    estimate_traffic_t t = estimate_traffic_t();
+    e.addRead(t, size);
+    return e.getLineSeconds(t);
+}
+
+void
+CWriteEstimate::loadProfile(const string & fileName)
+{
+    FILE *f = fopen(fileName.c_str(), "r");
+    if (f == NULL)
+        CLogger::error("Cannot open profile file " + fileName, EXIT_MAIN_FILE_INOUT);
+    string json;
+    char buffer[4096];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0)
+        json.append(buffer, n);
+    fclose(f);
+
+    // Values written by CStats, keys are unique in the file
+    const char *keys[] = { "\"open\":", "\"bootstrap\":", "\"avgMs\":", "\"lineBytesPerSecond\":" };
+    double v[4];
+    for (int i = 0; i < 4; ++i) {
+        size_t p = json.find(keys[i]);
+        const char *s = (p == string::npos) ? 0 : json.c_str() + p + strlen(keys[i]);
+        char *e = 0;
+        if (s != 0)
+            v[i] = strtod(s, &e);
+        if ((s == 0) || (e == s) || (v[i] < 0))
+            CLogger::error("File " + fileName + " is not a statistics file written by --stats-json",
+                           EXIT_MAIN_FILE_INOUT);
+    }
+
+    mConnectTime = v[0] + v[1];
+    // Block round trip is the line time of the block at the measured
+    // speed plus the latency
+    if ((v[2] > 0) && (v[3] > 0)) {
+        double l = v[2] / 1000 - (BLOCK_LENGTH + BLOCK_STATUS_LENGTH) / v[3];
+        mLatency = (l > 0) ? l : 0;
+    }
+}
+
+const estimate_traffic_t &
+CWriteEstimate::getTraffic(estimate_phase_t phase) const
+{
+    return mPhases[phase];
+}
+
+double
+CWriteEstimate::getLineSeconds(const estimate_traffic_t & t) const
+{
+    return (t.bytesOut + t.bytesIn) / mLineRate + t.handshakes * mLatency;
+}
+
+double
+CWriteEstimate::getSeconds(estimate_phase_t phase) const
+{
+    const estimate_traffic_t & t = mPhases[phase];
+    double s = getLineSeconds(t) + t.erasedBlocks * mSpecifics.getBlockEraseTime() / 1000.0;
+    // Measured reset and ping replace the modelled ping
+    if ((phase == ESTIMATE_BOOTSTRAP) && (mConnectTime >= 0))
+        s += mConnectTime - mLatency;
+    return s;
+}
+
+double
+CWriteEstimate::getMaxEraseSeconds() const
+{
+    return mEraseCommands * mSpecifics.getEraseTimeout() / 1000.0;
+}
+
+void
+CWriteEstimate::print() const
+{
+    const CWritePlan & p = mPlan;
+    list<unsigned int>::const_iterator it;
+
+    cout << "Plan for " << mSpecifics.getName() << " at " << mSpeed << " Bd" << endl;
+    cout << "  Erase                  ";
+    if (p.getEraseWhole()) {
+        cout << "whole memory";
+    } else if (p.getEraseBlocks().empty()) {
+        cout << "none";
+    } else {
+        cout << "blocks";
+        for (it = p.getEraseBlocks().begin(); it != p.getEraseBlocks().end(); ++it)
+            cout << (it == p.getEraseBlocks().begin() ? " " : ",") << *it;
+        uint16_t mask = CMcu::getEraseMask(p.getEraseBlocks(), mSpecifics.getBlockSizes().size());
+        cout << " (mask = " << CLogger::decToHex(mask) << ")";
+    }
+    cout << endl;
+    if (!p.getPreservedBlocks().empty()) {
+        cout << "  Kept blocks            ";
+        for (it = p.getPreservedBlocks().begin(); it != p.getPreservedBlocks().end(); ++it)
+            cout << (it == p.getPreservedBlocks().begin() ? "" : ",") << *it;
+        cout << ", " << p.getReadBackLength() << " bytes read back" << endl;
+    }
+
+    const estimate_traffic_t & t = mPhases[ESTIMATE_TRANSFER];
+    uint64_t padding = 0;
+    unsigned int handshakes = 0;
+    for (int i = 0; i < ESTIMATE_PHASE_COUNT; ++i) {
+        padding += mPhases[i].paddingBytes;
+        handshakes += mPhases[i].handshakes;
+    }
+    cout << "  Transfer               " << p.getTransferLength() << " bytes in " << t.blocks
+         << " blocks, " << (t.bytesOut + t.bytesIn) << " bytes on line" << endl;
+    cout << "  Padding                " << padding << " bytes" << endl;
+    cout << "  Handshakes             " << handshakes << ", " << fixed << setprecision(3)
+         << (mLatency * 1000) << " ms latency each" << endl;
+    if (mEraseCommands > 0)
+        cout << "  Erase time             " << setprecision(1)
+             << getSeconds(ESTIMATE_ERASE) << " s typical, at most " << getMaxEraseSeconds() << " s" << endl;
+
+    cout << "  Phase            Host->MCU  MCU->host  Handshakes      Time" << endl;
+    double total = 0;
+    for (int i = 0; i < ESTIMATE_PHASE_COUNT; ++i) {
+        const estimate_traffic_t & ph = mPhases[i];
+        double s = getSeconds((estimate_phase_t) i);
+        total += s;
+        cout << "    " << left << setw(13) << phaseNames[i] << right << setw(10) << ph.bytesOut
+             << setw(11) << ph.bytesIn << setw(12) << ph.handshakes << setw(9) << setprecision(3) << s
+             << " s" << endl;
+    }
+    cout << "    " << left << setw(46) << "total" << right << setw(9) << total << " s" << endl;
+}
@@ -0,0 +1,76 @@
+#ifndef WRITE_ESTIMATE_HPP
+#define WRITE_ESTIMATE_HPP 1
+
+#include "McuSpecifics.hpp"
+#include "WritePlan.hpp"
+
+#include <cstdint>
+#include <string>
+
+using std::string;
+
+// Phases of a write session
+typedef enum {
+    ESTIMATE_BOOTSTRAP,   // Ping and firmware upload
+    ESTIMATE_ERASE,
+    ESTIMATE_READ_BACK,   // Content of blocks kept by the write
+    ESTIMATE_TRANSFER,
+    ESTIMATE_VERIFY,      // Check of written data by reading
+    ESTIMATE_PHASE_COUNT
+} estimate_phase_t;
+
+// Traffic of one phase on the serial line
+typedef struct {
+    uint64_t bytesOut;        // Sent by host, padding included
+    uint64_t bytesIn;
+    uint64_t paddingBytes;
+    unsigned int handshakes;  // Host waits for an answer before it continues
+    unsigned int blocks;
+    unsigned int erasedBlocks;
+} estimate_traffic_t;
+
+// Estimate of a write session computed from its plan without a device.
+// Time of a phase is the line time of its bytes, a turnaround latency for
+// each handshake and the typical erase time of erased blocks. Latency and
+// connect time can be taken from statistics measured on a station.
+class CWriteEstimate {
+private:
+    IMcuSpecifics & mSpecifics;
+    const CWritePlan & mPlan;
+    uint32_t mSpeed;
+    double mLineRate;      // B/s
+    double mLatency;       // s
+    double mConnectTime;   // s, measured reset and ping, -1 when modelled
+    bool mPipelined;
+    unsigned int mConfigWords;
+    unsigned int mEraseCommands;
+    estimate_traffic_t mPhases[ESTIMATE_PHASE_COUNT];
+
+    void addSafeValues(estimate_traffic_t & t, unsigned int words, unsigned int bytes) const;
+    void addShellCommand(estimate_traffic_t & t) const;
+    void addRead(estimate_traffic_t & t, uint32_t size) const;
+    void addWrite(estimate_traffic_t & t, uint32_t size) const;
+    double getLineSeconds(const estimate_traffic_t & t) const;
+
+public:
+    // Speed in Bd, "0" is the default speed
+    CWriteEstimate(IMcuSpecifics & specifics, const CWritePlan & plan, bool checkByRead,
+                   const string & speed, float mcuFrequency, bool pipelined);
+
+    // Time of reading size bytes from address 0 by a loaded shell, e.g.
+    // by the blank check
+    static double getReadSeconds(IMcuSpecifics & specifics, uint32_t size, const string & speed,
+                                 float mcuFrequency, bool pipelined);
+
+    // Take handshake latency and connect time from a file written by
+    // --stats-json, fails when the file cannot be read
+    void loadProfile(const string & fileName);
+
+    const estimate_traffic_t & getTraffic(estimate_phase_t phase) const;
+    double getSeconds(estimate_phase_t phase) const;
+    // Upper bound of erase time given by the erase timeout of the MCU
+    double getMaxEraseSeconds() const;
+    void print() const;
+};
+
+#endif
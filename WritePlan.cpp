@@ -0,0 +1,158 @@
+#include "WritePlan.hpp"
+#include "ExitCodes.hpp"
+#include "Logger.hpp"
+
+#include <cstring>
+#include <sstream>
+
+using std::ostringstream;
+
+#define PAD_BYTE 0xFF
+
+CWritePlan::CWritePlan(const CImage & image, const list<uint32_t> & blockSizes,
+                       uint32_t flashSize, bool eraseWhole, const CImage * overlay)
+    : mLayout(blockSizes), mEraseWhole(eraseWhole), mTransferLength(0), mReadBackLength(0)
+{
+    uint32_t endAddr = image.getEndAddress();
+    if (overlay && (overlay->getEndAddress() > endAddr))
+        endAddr = overlay->getEndAddress();
+    plan(&image, overlay, endAddr, flashSize);
+}
+
+CWritePlan::CWritePlan(uint32_t length, const list<uint32_t> & blockSizes,
+                       uint32_t flashSize, bool eraseWhole)
+    : mLayout(blockSizes), mEraseWhole(eraseWhole), mTransferLength(0), mReadBackLength(0)
+{
+    plan(0, 0, length, flashSize);
+}
+
+void
+CWritePlan::plan(const CImage * image, const CImage * overlay, uint32_t endAddr,
+                 uint32_t flashSize)
+{
+    if (endAddr > flashSize) {
+        ostringstream os;
+        os << "Data at addresses up to " << CLogger::decToHex(endAddr - 1);
+        os << " are out of FLASH memory range [0," << CLogger::decToHex(flashSize - 1) << "]";
+        CLogger::error(os.str(), EXIT_MCU);
+    }
+
+    mTransferLength = endAddr;
+
+    // Blocks with data, without image all blocks below end address
+    vector<bool> hasData(mLayout.getBlockCount(), false);
+    list<unsigned int> l;
+    list<unsigned int>::const_iterator it;
+    if (image) {
+        l = mLayout.getBlocksWithData(*image);
+    } else {
+        for (unsigned int i = 0; (i < mLayout.getBlockCount()) && (mLayout.getBlock(i).start < endAddr); ++i)
+            l.push_back(i);
+    }
+    if (overlay)
+        l.splice(l.end(), mLayout.getBlocksWithData(*overlay));
+    for (it = l.begin(); it != l.end(); ++it)
+        hasData[*it] = true;
+
+    for (unsigned int i = 0; i < mLayout.getBlockCount(); ++i) {
+        const CImage::range_t & r = mLayout.getBlock(i);
+        if (hasData[i]) {
+            if (!mEraseWhole)
+                mEraseBlocks.push_back(i);
+        } else if (!mEraseWhole && (r.start < mTransferLength)) {
+            // Programmed over, keep its content
+            mPreservedBlocks.push_back(i);
+            mReadBackLength = r.end;
+        }
+    }
+}
+
+void
+CWritePlan::avoidErase(const vector<uint8_t> & current, const vector<uint8_t> & data)
+{
+    if (mEraseWhole)
+        return;
+
+    list<unsigned int> erase;
+    uint32_t transferEnd = 0;
+    for (list<unsigned int>::const_iterator it = mEraseBlocks.begin(); it != mEraseBlocks.end(); ++it) {
+        const CImage::range_t & r = mLayout.getBlock(*it);
+        uint32_t end = (r.end < mTransferLength) ? r.end : mTransferLength;
+
+        if (!memcmp(current.data() + r.start, data.data() + r.start, end - r.start)) {
+            mSkippedBlocks.push_back(*it);
+            continue;
+        }
+
+        // Programming can only change bits from 1 to 0
+        uint32_t a = r.start;
+        while ((a < end) && ((current[a] & data[a]) == data[a]))
+            ++a;
+        if (a == end)
+            mProgrammedBlocks.push_back(*it);
+        else
+            erase.push_back(*it);
+        transferEnd = end;
+    }
+
+    mEraseBlocks = erase;
+    mTransferLength = transferEnd;
+}
+
+bool
+CWritePlan::getEraseWhole() const
+{
+    return mEraseWhole;
+}
+
+const list<unsigned int> &
+CWritePlan::getEraseBlocks() const
+{
+    return mEraseBlocks;
+}
+
+const list<unsigned int> &
+CWritePlan::getPreservedBlocks() const
+{
+    return mPreservedBlocks;
+}
+
+const list<unsigned int> &
+CWritePlan::getProgrammedBlocks() const
+{
+    return mProgrammedBlocks;
+}
+
+const list<unsigned int> &
+CWritePlan::getSkippedBlocks() const
+{
+    return mSkippedBlocks;
+}
+
+uint32_t
+CWritePlan::getTransferLength() const
+{
+    return mTransferLength;
+}
+
+uint32_t
+CWritePlan::getReadBackLength() const
+{
+    return mReadBackLength;
+}
+
+void
+CWritePlan::getTransferData(const CImage & image, const vector<uint8_t> & current,
+                            vector<uint8_t> & data) const
+{
+    // Gaps in erased blocks are programmed with erased value
+    data.assign(mTransferLength, PAD_BYTE);
+
+    list<unsigned int>::const_iterator it;
+    for (it = mPreservedBlocks.begin(); it != mPreservedBlocks.end(); ++it) {
+        const CImage::range_t & r = mLayout.getBlock(*it);
+        memcpy(data.data() + r.start, current.data() + r.start, r.end - r.start);
+    }
+
+    image.copyTo(0, data.data(), mTransferLength);
+}
@@ -0,0 +1,58 @@
+#ifndef WRITE_PLAN_HPP
+#define WRITE_PLAN_HPP 1
+
+#include "Image.hpp"
+#include "BlockLayout.hpp"
+
+#include <cstdint>
+#include <list>
+#include <vector>
+
+using std::list;
+using std::vector;
+
+// Plan of a write operation for a sparse image. Only blocks containing
+// image data are erased. Stage 2 firmware programs memory from address 0
+// on, so blocks below the image end which are not erased are read back
+// first and programmed with their current content.
+class CWritePlan {
+private:
+    CBlockLayout mLayout;
+    list<unsigned int> mEraseBlocks;
+    list<unsigned int> mPreservedBlocks;
+    list<unsigned int> mProgrammedBlocks;
+    list<unsigned int> mSkippedBlocks;
+    bool mEraseWhole;
+    uint32_t mTransferLength;
+    uint32_t mReadBackLength;
+
+    void plan(const CImage * image, const CImage * overlay, uint32_t endAddr,
+              uint32_t flashSize);
+
+public:
+    // Data of optional overlay are written over the image
+    CWritePlan(const CImage & image, const list<uint32_t> & blockSizes,
+               uint32_t flashSize, bool eraseWhole, const CImage * overlay = 0);
+    // Plan for contiguous data of given length from address 0, e.g. a
+    // stream whose content is not known in advance
+    CWritePlan(uint32_t length, const list<uint32_t> & blockSizes,
+               uint32_t flashSize, bool eraseWhole);
+
+    // Compare transfer data with current memory content, both of transfer
+    // length. Blocks where new data only clear bits are programmed over
+    // without erase, identical blocks are not erased at all and transfer
+    // ends with the last block which is erased or programmed over.
+    void avoidErase(const vector<uint8_t> & current, const vector<uint8_t> & data);
+
+    bool getEraseWhole() const;
+    const list<unsigned int> & getEraseBlocks() const;
+    const list<unsigned int> & getPreservedBlocks() const;
+    const list<unsigned int> & getProgrammedBlocks() const;
+    const list<unsigned int> & getSkippedBlocks() const;
+    uint32_t getTransferLength() const;
+    uint32_t getReadBackLength() const;
+    void getTransferData(const CImage & image, const vector<uint8_t> & current,
+                         vector<uint8_t> & data) const;
+};
+
+#endif
@@ -0,0 +1,290 @@
+#include "WriteSession.hpp"
+#include "ExitCodes.hpp"
+#include "Logger.hpp"
+#include "DataSource.hpp"
+#include "Verifier.hpp"
+#include "BlankCheck.hpp"
+#include "BlockLayout.hpp"
+#include "Timeline.hpp"
+
+#include <cstring>
+#include <sstream>
+#include <iomanip>
+#include <vector>
+#include <chrono>
+
+using std::ostringstream;
+using std::vector;
+
+CWriteSession::CWriteSession(CMcu & mcu, const write_options_t & options, bool printProgress)
+    : mMcu(mcu), mOptions(options), mPrintProgress(printProgress)
+{
+    ;
+}
+
+void
+CWriteSession::erase(list<unsigned int> blocks, bool skipBlank)
+{
+    if (skipBlank) {
+        CBlockLayout layout(mMcu.getBlockSizes());
+        bool whole = blocks.empty();
+        if (whole) {
+            for (unsigned int i = 0; i < layout.getBlockCount(); ++i)
+                blocks.push_back(i);
+        }
+        CBlankCheck check(layout, blocks);
+
+        // Memory is read from address 0 up to the last checked block. The
+        // check pays off only when it is shorter than erase of all checked
+        // blocks, which is the saving when all of them are blank.
+        double readSeconds = mMcu.getReadSeconds(check.getReadLength(), mOptions.serialSpeed,
+                                                 mOptions.pipelined);
+        double eraseSeconds = blocks.size() * mMcu.getBlockEraseTime() / 1000.0;
+        if (readSeconds >= eraseSeconds) {
+            ostringstream os;
+            os << "Blank check skipped, reading takes about " << std::fixed << std::setprecision(1)
+               << readSeconds << " s, erase " << eraseSeconds << " s";
+            CLogger::message(os.str());
+            if (whole)
+                blocks.clear();
+        } else {
+            CLogger::info("Checking blank blocks by reading memory");
+            std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+            mMcu.blankCheck(check, mPrintProgress);
+            double checkSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now()
+                                                                - start).count();
+
+            list<unsigned int> used;
+            list<unsigned int> blank;
+            for (list<unsigned int>::const_iterator it = blocks.begin(); it != blocks.end(); ++it) {
+                if (check.isBlank(*it))
+                    blank.push_back(*it);
+                else
+                    used.push_back(*it);
+            }
+
+            if (!blank.empty()) {
+                ostringstream os;
+                os << "Blocks already blank:";
+                for (list<unsigned int>::const_iterator it = blank.begin(); it != blank.end(); ++it)
+                    os << (it == blank.begin() ? " " : ",") << *it;
+                // Read may take longer than estimated, e.g. on a loaded host
+                double saved = blank.size() * mMcu.getBlockEraseTime() / 1000.0 - checkSeconds;
+                os << std::fixed << std::setprecision(1);
+                if (saved >= 0)
+                    os << ", about " << saved << " s saved by erase time skipped less "
+                       << checkSeconds << " s of blank check";
+                else
+                    os << ", about " << -saved << " s lost by " << checkSeconds
+                       << " s of blank check longer than erase time skipped";
+                CLogger::message(os.str());
+            }
+            if (used.empty()) {
+                CLogger::info("No block needs to be erased");
+                return;
+            }
+            blocks.clear();
+            if (!whole || !blank.empty())
+                blocks = used;
+        }
+    }
+
+    if (blocks.empty()) {
+        CLogger::info("Erasing whole memory");
+        mMcu.erase();
+    } else {
+        CLogger::info("Erasing memory by blocks");
+        mMcu.erase(blocks);
+    }
+}
+
+void
+CWriteSession::writeImage(const CImage & image, const CImage & patches)
+{
+    CWritePlan plan(image, mMcu.getBlockSizes(), mMcu.getFlashSize(), mOptions.eraseWholeMemory,
+                    &patches);
+
+    // Content of blocks which are programmed over but not erased, all
+    // data are compared with current content when erase is avoided
+    uint32_t readLength = plan.getReadBackLength();
+    if (mOptions.avoidErase)
+        readLength = plan.getTransferLength();
+    vector<uint8_t> current;
+    if (readLength > 0) {
+        ostringstream os;
+        if (mOptions.avoidErase)
+            os << "Reading " << readLength << " bytes to compare current content with data";
+        else
+            os << "Reading " << readLength << " bytes to keep content of blocks not covered by data";
+        CLogger::info(os.str());
+        current = mMcu.read(readLength, false);
+    }
+
+    vector<uint8_t> data;
+    const uint8_t *transfer = 0;
+    if (mOptions.avoidErase) {
+        plan.getTransferData(image, current, data);
+        patches.copyTo(0, data.data(), data.size());
+        plan.avoidErase(current, data);
+        reportAvoidedErase(plan);
+        transfer = data.data();
+    }
+
+    erasePlanned(plan);
+
+    if (mOptions.avoidErase && (plan.getTransferLength() == 0)) {
+        CLogger::message("Memory already contains the data, nothing to write");
+        return;
+    }
+
+    // Image covering the transfer in one extent (raw binary file) is sent
+    // directly from its file mapping, otherwise transfer data are composed
+    if ((transfer == 0) && (plan.getReadBackLength() == 0))
+        transfer = image.getContiguousData(0, plan.getTransferLength());
+    if (transfer == 0) {
+        plan.getTransferData(image, current, data);
+        transfer = data.data();
+    }
+
+    CMemorySource base(transfer, plan.getTransferLength());
+    COverlaySource source(base, patches);
+    CLogger::info("Writing memory");
+    mMcu.write(source, plan.getTransferLength(), mPrintProgress);
+
+    if (mOptions.checkByRead)
+        checkWritten(transfer, plan.getTransferLength(), patches);
+}
+
+void
+CWriteSession::writeStream(FILE *file, const string & name, uint32_t length,
+                           const CImage & patches)
+{
+    CWritePlan plan(length, mMcu.getBlockSizes(), mMcu.getFlashSize(), mOptions.eraseWholeMemory);
+
+    if (patches.getEndAddress() > length)
+        CLogger::error("Patches must lie within streamed data", EXIT_USER_CONFIG);
+
+    erasePlanned(plan);
+
+    // Data are kept only when they are checked after write
+    vector<uint8_t> written;
+    CStreamSource stream(file, name, mOptions.checkByRead ? &written : 0);
+    COverlaySource source(stream, patches);
+
+    CLogger::info("Writing memory");
+    mMcu.write(source, length, mPrintProgress);
+
+    if (mOptions.checkByRead)
+        checkWritten(written.data(), length, patches);
+}
+
+void
+CWriteSession::erasePlanned(const CWritePlan & plan)
+{
+    // Blocks left for erase by --avoid-erase are known to be used
+    bool skipBlank = mOptions.skipBlank && !mOptions.avoidErase;
+
+    if (plan.getEraseWhole())
+        erase(list<unsigned int>(), skipBlank);
+    else if (!plan.getEraseBlocks().empty())
+        erase(plan.getEraseBlocks(), skipBlank);
+}
+
+void
+CWriteSession::reportAvoidedErase(const CWritePlan & plan)
+{
+    const list<unsigned int> & programmed = plan.getProgrammedBlocks();
+    const list<unsigned int> & skipped = plan.getSkippedBlocks();
+    list<unsigned int>::const_iterator it;
+
+    if (!programmed.empty()) {
+        ostringstream os;
+        os << "Blocks programmed without erase:";
+        for (it = programmed.begin(); it != programmed.end(); ++it)
+            os << (it == programmed.begin() ? " " : ",") << *it;
+        CLogger::info(os.str());
+    }
+    if (!skipped.empty()) {
+        ostringstream os;
+        os << "Blocks already containing the data:";
+        for (it = skipped.begin(); it != skipped.end(); ++it)
+            os << (it == skipped.begin() ? " " : ",") << *it;
+        CLogger::info(os.str());
+    }
+
+    size_t avoided = programmed.size() + skipped.size();
+    if (avoided > 0) {
+        ostringstream os;
+        os << "Erase of " << avoided << " blocks avoided, about " << std::fixed << std::setprecision(1)
+           << (avoided * mMcu.getBlockEraseTime() / 1000.0) << " s saved";
+        CLogger::message(os.str());
+    }
+}
+
+void
+CWriteSession::checkWritten(const uint8_t *data, uint32_t length, const CImage & patches)
+{
+    CBlockLayout layout(mMcu.getBlockSizes());
+    list<unsigned int> repaired;
+
+    for (int attempt = 0; ; ++attempt) {
+        CLogger::info("Checking result of write operation by reading");
+
+        CMemorySource base(data, length);
+        COverlaySource expected(base, patches);
+        CVerifier verifier(expected, layout, mOptions.verifyAbortAfter);
+        {
+            CTimelineSpan span("verify", "main");
+            mMcu.read(length, verifier, false);
+        }
+        if (!verifier.hasMismatch())
+            break;
+
+        verifier.report();
+        if (attempt >= mOptions.repairAttempts) {
+            ostringstream os;
+            os << "Write operation unsucessful, " << verifier.getMismatchCount() << " bytes differ";
+            CLogger::error(os.str(), EXIT_MAIN_PROG_VERIFY);
+        }
+
+        // Erase failing blocks only. Firmware programs from address 0, data
+        // of blocks below them are programmed again with the same value.
+        list<unsigned int> blocks = verifier.getMismatchBlocks();
+        ostringstream os;
+        os << "Repairing blocks";
+        for (list<unsigned int>::const_iterator it = blocks.begin(); it != blocks.end(); ++it)
+            os << (it == blocks.begin() ? " " : ",") << *it;
+        os << ", attempt " << (attempt + 1) << " of " << mOptions.repairAttempts;
+        CLogger::warning(os.str());
+        CTimeline::mark("repair", "retry");
+
+        // Last block can reach beyond the data, e.g. a block programmed
+        // over by --avoid-erase whose tail was not transferred. Content
+        // of the tail is read before the erase and written back.
+        uint32_t end = layout.getBlock(blocks.back()).end;
+        vector<uint8_t> rewriteData;
+        const uint8_t *rewriteBuffer = data;
+        if (end > length) {
+            rewriteData = mMcu.read(end, false);
+            memcpy(rewriteData.data(), data, length);
+            rewriteBuffer = rewriteData.data();
+        }
+
+        mMcu.erase(blocks);
+        CMemorySource rewriteBase(rewriteBuffer, end);
+        COverlaySource rewrite(rewriteBase, patches);
+        mMcu.write(rewrite, end, false);
+        repaired.merge(blocks);
+    }
+
+    if (!repaired.empty()) {
+        repaired.unique();
+        ostringstream os;
+        os << "Repaired blocks";
+        for (list<unsigned int>::const_iterator it = repaired.begin(); it != repaired.end(); ++it)
+            os << (it == repaired.begin() ? " " : ",") << *it;
+        CLogger::message(os.str());
+    }
+
+    CLogger::info("Write operation was successful");
+}
@@ -0,0 +1,54 @@
+#ifndef WRITE_SESSION_HPP
+#define WRITE_SESSION_HPP 1
+
+#include "Mcu.hpp"
+#include "Image.hpp"
+#include "WritePlan.hpp"
+
+#include <cstdio>
+#include <cstdint>
+#include <list>
+#include <string>
+
+using std::list;
+using std::string;
+
+// Options of the write operation which drive its session
+typedef struct {
+    bool eraseWholeMemory;   // -e
+    bool checkByRead;        // -c
+    bool avoidErase;         // --avoid-erase
+    bool skipBlank;          // --skip-blank
+    int repairAttempts;      // --repair
+    int verifyAbortAfter;    // --abort-after
+    string serialSpeed;      // Line speed, the blank check is estimated by it
+    bool pipelined;
+} write_options_t;
+
+// Write session with the MCU: erase of planned blocks, transfer of data
+// with patches written over them and the check by read with repair of
+// failed blocks. Shared by the write and station operations and by the
+// benchmark.
+class CWriteSession {
+private:
+    CMcu & mMcu;
+    write_options_t mOptions;
+    bool mPrintProgress;
+
+    void erasePlanned(const CWritePlan & plan);
+    void reportAvoidedErase(const CWritePlan & plan);
+    void checkWritten(const uint8_t *data, uint32_t length, const CImage & patches);
+
+public:
+    CWriteSession(CMcu & mcu, const write_options_t & options, bool printProgress);
+
+    // Empty list means whole memory. Blank blocks are not erased with
+    // skipBlank when their check is estimated to be shorter than the erase.
+    void erase(list<unsigned int> blocks, bool skipBlank);
+    void writeImage(const CImage & image, const CImage & patches);
+    // Stream of known length is written as it arrives, patches must lie
+    // within it
+    void writeStream(FILE *file, const string & name, uint32_t length, const CImage & patches);
+};
+
+#endif
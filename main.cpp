@@ -8,8 +8,11 @@
 #include <csignal>
 #include <string>
 #include <sstream>
+#include <iomanip>
 #include <vector>
+#include <list>
 #include <memory>
+#include <atomic>
 
 #include "ExitCodes.hpp"
 #include "Logger.hpp"
@@ -17,7 +20,28 @@
 #include "UserConfig.hpp"
 #include "SerialPortFactory.hpp"
 #include "SerialPort.hpp"
+#include "SerialPortTrace.hpp"
+#include "SerialPortTimeline.hpp"
 #include "Mcu.hpp"
+#include "Image.hpp"
+#include "HexFile.hpp"
+#include "SrecFile.hpp"
+#include "DataSink.hpp"
+#include "DataSource.hpp"
+#include "Verifier.hpp"
+#include "BlankCheck.hpp"
+#include "BlockLayout.hpp"
+#include "WritePlan.hpp"
+#include "WriteEstimate.hpp"
+#include "WriteSession.hpp"
+#include "Timeline.hpp"
+#include "Stats.hpp"
+#ifdef UNIX
+#include "Station.hpp"
+#else
+#include <io.h>     /* _setmode() */
+#include <fcntl.h>
+#endif
 
 using std::cout;
 using std::endl;
@@ -25,14 +49,21 @@ using std::string;
 using std::ostringstream;
 using std::vector;
 using std::unique_ptr;
+using std::list;
 
 void opSpeeds(CUserConfig & uc);
 void opRead(CUserConfig & uc, CMcu & mcu);
 void opErase(CUserConfig & uc, CMcu & mcu);
+void opBlank(CUserConfig & uc, CMcu & mcu);
 void opWrite(CUserConfig & uc, CMcu & mcu);
+void opVerify(CUserConfig & uc, CMcu & mcu);
+void opStation(CUserConfig & uc);
+void opPlan(CUserConfig & uc);
+write_options_t getWriteOptions(CUserConfig & uc);
+void getPatches(CUserConfig & uc, unsigned long unit, CImage & patches);
 
-vector<uint8_t> readDataFile(const string fpath);
-void writeDataFile(const string fpath, vector<uint8_t> data);
+void readDataFiles(const list<write_input_t> & inputs, CImage & image);
+void readDataFile(const write_input_t & input, CImage & image);
 
 // Global variable to be accessed in signal handler
 unique_ptr<CSerialPort> sp;
@@ -42,7 +73,8 @@ void
 signalHandler(int dummy)
 {
     CLogger::info("Exiting on signal");
-    sp->close();
+    if (sp)
+        sp->close();
     exit(EXIT_MAIN_SIGNAL);
 }
 
@@ -53,14 +85,37 @@ main(int argc, char **argv)
     signal(SIGINT, signalHandler);
 
     CSerialPortFactory serialPortFactory;
-    sp = serialPortFactory.getSerialPort();
     
     try {
 	// Parse user command line configuration
 	CUserConfig uc(argc, argv);
+	// Statistics are computed from the timeline
+	CTimeline::setFileName(uc.getTimelineFilename());
+	CStats::enable(uc.isStatsSet(), uc.getStatsFilename(), uc.getSerialSpeed());
+	if (!uc.getTimelineFilename().empty() || CStats::isEnabled())
+	    CTimeline::enable();
+	// Serial port backend depends on the port name
+	serialPortFactory.setReplayTimed(uc.isReplayTimedSet());
+	sp = serialPortFactory.getSerialPort(uc.getSerialPortName());
+	if (CTimeline::isEnabled())
+	    sp.reset(new CSerialPortTimeline(std::move(sp)));
+	if (!uc.getRecordFilename().empty())
+	    sp.reset(new CSerialPortRecorder(std::move(sp), uc.getRecordFilename()));
+	sp->setPipelinedHandshakes(uc.isPipelineSet());
 	// Configure logging
 	if (uc.isVerboseModeSet())
 	    CLogger::setLogInfo(true);
+	if (uc.isReadSet() && CFileSink::isStdout(uc.getReadOutputFname())) {
+	    CLogger::setMessagesToStderr(true);
+#ifndef UNIX
+	    _setmode(_fileno(stdout), _O_BINARY);
+#endif
+	}
+#ifndef UNIX
+	if ((uc.isWriteSet() || uc.isVerifySet() || uc.isStationSet() || uc.isPlanSet())
+            && !uc.getWriteInputFname().compare("-"))
+	    _setmode(_fileno(stdin), _O_BINARY);
+#endif
 	// Execute selected operation
 	if (uc.isHelpSet()) {
             cout << uc.getHelpMessage(string(argv[0]));
@@ -68,29 +123,54 @@ main(int argc, char **argv)
             cout << PROGRAM_NAME << " " << PROGRAM_VERSION << endl;
 	} else if (uc.isSpeedsSet()) {
 	    opSpeeds(uc);
-	} else if (uc.isIdentSet() || uc.isEraseSet() || uc.isReadSet() || uc.isWriteSet()) {
+	} else if (uc.isStationSet()) {
+	    opStation(uc);
+	} else if (uc.isPlanSet()) {
+	    opPlan(uc);
+	} else if (uc.isIdentSet() || uc.isEraseSet() || uc.isReadSet() || uc.isWriteSet()
+                   || uc.isVerifySet() || uc.isBlankSet()) {
+	    CTimelineSpan span("operation", "main");
 	    // Open serial port
 	    sp->open(uc.getSerialPortName(), uc.getSerialSpeed());
 	    // Get MCU model
-	    unique_ptr<CMcu> mcu(new CMcu(*sp, uc.getMcuFrequency()));
+	    unique_ptr<CMcu> mcu(new CMcu(*sp, uc.getMcuFrequency(), uc.getResetSequence()));
 	    // Execute requested operation
             if (!uc.isIdentSet()) {
+                // All other operations use the shell. Loading it first
+                // leaves MCU ready even when the operation fails on its
+                // arguments.
+                mcu->init();
                 if (uc.isReadSet())
                     opRead(uc, *mcu);
                 else if (uc.isEraseSet())
                     opErase(uc, *mcu);
                 else if (uc.isWriteSet())
                     opWrite(uc, *mcu);
+                else if (uc.isVerifySet())
+                    opVerify(uc, *mcu);
+                else if (uc.isBlankSet())
+                    opBlank(uc, *mcu);
             } else {
                 cout << mcu->ident() << endl;
+                // Leave MCU ready for following operations unless user
+                // wants only the identification
+                if (!uc.getIdentQuick())
+                    mcu->init();
             }
 	} else {
 	    CLogger::error("No operation requested. To get help type: " + string(argv[0]) + " help" , EXIT_MAIN_NOOP);
 	}
 	
 	sp->close();
+	if (!CTimeline::save())
+	    CLogger::error("Cannot write timeline file " + CTimeline::getFileName(), EXIT_MAIN_FILE_INOUT);
+	if (!CStats::report())
+	    CLogger::error("Cannot write statistics file " + CStats::getJsonFileName(), EXIT_MAIN_FILE_INOUT);
 	return 0;
     } catch (CExitException & e) {
+	// Timeline of a failed operation is the most interesting one
+	CTimeline::save();
+	CStats::report();
 	return e.getReturnValue();
     }
 }
@@ -110,110 +190,263 @@ opRead(CUserConfig & uc, CMcu & mcu)
     CLogger::info("Reading memory");
     
     int rl = uc.getReadLength();
-    vector<uint8_t> r;
-    
     if (rl == -1)
-	r = mcu.read(uc.isPrintProgressSet());
-    else
-    	r = mcu.read(rl, uc.isPrintProgressSet());    
-    // Write data file musi dostat spravnu hodnotu
-    writeDataFile(uc.getReadOutputFname(), r);
+        rl = mcu.getFlashSize();
+
+    // Blocks go to the output as they arrive, whole dump is never in memory
+    CFileSink file(uc.getReadOutputFname());
+    if (CSrecFile::hasSrecExtension(uc.getReadOutputFname())) {
+        CSrecWriter srec(uc.getReadOutputFname(), file);
+        mcu.read(rl, srec, uc.isPrintProgressSet());
+    } else {
+        mcu.read(rl, file, uc.isPrintProgressSet());
+    }
 }
 
 void
 opErase(CUserConfig & uc, CMcu & mcu)
 {
-    if (uc.getEraseBlockList().size() != 0) {
-	CLogger::info("Erasing memory by blocks");
-	mcu.erase(uc.getEraseBlockList());
-    } else {
-	CLogger::info("Erasing whole memory");
-	mcu.erase();
+    CWriteSession session(mcu, getWriteOptions(uc), uc.isPrintProgressSet());
+    session.erase(uc.getEraseBlockList(), uc.getEraseSkipBlank());
+}
+
+void
+opBlank(CUserConfig & uc, CMcu & mcu)
+{
+    CBlockLayout layout(mcu.getBlockSizes());
+    list<unsigned int> blocks = uc.getBlankBlockList();
+    if (blocks.empty()) {
+        for (unsigned int i = 0; i < layout.getBlockCount(); ++i)
+            blocks.push_back(i);
+    }
+    blocks.sort();
+    blocks.unique();
+
+    CLogger::info("Checking blocks by reading memory");
+    CBlankCheck check(layout, blocks);
+    mcu.blankCheck(check, uc.isPrintProgressSet());
+
+    for (list<unsigned int>::const_iterator it = blocks.begin(); it != blocks.end(); ++it) {
+        cout << "Block " << *it << ": ";
+        if (check.isBlank(*it))
+            cout << "blank" << endl;
+        else
+            cout << "first used address " << CLogger::decToHex(check.getFirstUsed(*it)) << endl;
     }
 }
 
 void
 opWrite(CUserConfig & uc, CMcu & mcu)
 {
-    vector<uint8_t> data;
+    CWriteSession session(mcu, getWriteOptions(uc), uc.isPrintProgressSet());
+    CImage patches;
+    getPatches(uc, 0, patches);
 
-    data = readDataFile(uc.getWriteInputFname());
-    
-    if (uc.getWriteEraseWholeMemory()) {
-	CLogger::info("Erasing whole memory");
-    	mcu.erase();
-    } else {
-	CLogger::info("Erasing memory by blocks");
-    	mcu.erase(0, data.size() - 1);
+    // Stream of known length is written as it arrives
+    if (uc.getWriteLength() != -1) {
+        session.writeStream(stdin, "standard input", uc.getWriteLength(), patches);
+        return;
     }
 
-    CLogger::info("Writing memory");
-    mcu.write(data, uc.isPrintProgressSet());
+    CImage image;
 
-    if (uc.getWriteCheckByRead()) {
-	CLogger::info("Checking result of write operation by reading");
+    readDataFiles(uc.getWriteInputs(), image);
+    session.writeImage(image, patches);
+}
 
-	vector<uint8_t> rdata =	mcu.read(data.size());
-	for (size_t i = 0; i < data.size(); i++) {
-	    if (rdata[i] != data[i])
-		CLogger::error("Write operation unsucessful", EXIT_MAIN_PROG_VERIFY);
-	}
+write_options_t
+getWriteOptions(CUserConfig & uc)
+{
+    write_options_t o;
+    o.eraseWholeMemory = uc.getWriteEraseWholeMemory();
+    o.checkByRead = uc.getWriteCheckByRead();
+    o.avoidErase = uc.getWriteAvoidErase();
+    o.skipBlank = uc.getEraseSkipBlank();
+    o.repairAttempts = uc.getWriteRepairAttempts();
+    o.verifyAbortAfter = uc.getVerifyAbortAfter();
+    o.serialSpeed = uc.getSerialSpeed();
+    o.pipelined = uc.isPipelineSet();
+    return o;
+}
+
+void
+getPatches(CUserConfig & uc, unsigned long unit, CImage & patches)
+{
+    const vector<CPatch> & p = uc.getWritePatches();
 
-	CLogger::info("Write operation was successful");
+    for (vector<CPatch>::const_iterator it = p.begin(); it != p.end(); ++it) {
+        vector<uint8_t> d = it->getData(unit);
+        patches.addData(it->getAddress(), d.data(), d.size());
+
+        ostringstream os;
+        os << "Patch at " << CLogger::decToHex(it->getAddress()) << ": ";
+        for (size_t i = 0; i < d.size(); ++i)
+            os << std::hex << std::uppercase << std::setw(2) << std::setfill('0') << (int) d[i];
+        CLogger::message(os.str());
     }
 }
 
+void
+opVerify(CUserConfig & uc, CMcu & mcu)
+{
+    CImage image;
+    readDataFiles(uc.getWriteInputs(), image);
+
+    if (image.empty())
+        CLogger::error("Reference file has no data", EXIT_MAIN_FILE_INOUT);
+    if (image.getEndAddress() > mcu.getFlashSize()) {
+        ostringstream os;
+        os << "Reference data at addresses up to " << CLogger::decToHex(image.getEndAddress() - 1);
+        os << " are out of FLASH memory range [0," << CLogger::decToHex(mcu.getFlashSize() - 1) << "]";
+        CLogger::error(os.str(), EXIT_MCU);
+    }
+
+    // Memory is read from address 0, only bytes defined by reference count
+    CLogger::info("Verifying memory");
+    CBlockLayout layout(mcu.getBlockSizes());
+    CImageSource expected(image);
+    CVerifier verifier(expected, layout, uc.getVerifyAbortAfter(), &image);
+    {
+        CTimelineSpan span("verify", "main");
+        mcu.read(image.getEndAddress(), verifier, uc.isPrintProgressSet());
+    }
+
+    if (verifier.hasMismatch()) {
+        verifier.report();
+        ostringstream os;
+        os << "Memory differs from reference in " << verifier.getMismatchCount() << " bytes";
+        CLogger::error(os.str(), EXIT_MAIN_VERIFY_MISMATCH);
+    }
+    CLogger::info("Memory matches reference");
+}
 
-vector<uint8_t>
-readDataFile(const string fpath)
+void
+opStation(CUserConfig & uc)
 {
-    FILE *f;
-    size_t size;    
 #ifdef UNIX
-    char mode[3] = "r";
+    // All boards get the same image, patches differ by unit number
+    CImage image;
+    readDataFiles(uc.getWriteInputs(), image);
+    std::atomic<unsigned long> nextUnit(0);
+
+    CStation station(uc.getStationDirectory(), uc.getStationPattern(),
+                     [&uc, &image, &nextUnit](const string & devicePath) -> uint32_t {
+        unsigned long unit = nextUnit++;
+        CTimelineSpan span("board", "main");
+        CSerialPortFactory serialPortFactory;
+        unique_ptr<CSerialPort> port = serialPortFactory.getSerialPort(devicePath);
+        if (CTimeline::isEnabled())
+            port.reset(new CSerialPortTimeline(std::move(port)));
+
+        port->setPipelinedHandshakes(uc.isPipelineSet());
+        port->open(devicePath, uc.getSerialSpeed());
+        CMcu mcu(*port, uc.getMcuFrequency(), uc.getResetSequence());
+        // Patches of this unit are written over the shared image
+        CImage patches;
+        getPatches(uc, unit, patches);
+        // Progress of concurrent jobs would be mixed together
+        CWriteSession session(mcu, getWriteOptions(uc), false);
+        session.writeImage(image, patches);
+        port->close();
+
+        return image.getDataSize();
+    });
+
+    unsigned int failed = station.run(uc.getStationCount());
+    if (failed != 0) {
+        ostringstream os;
+        os << "Programming of " << failed << " boards failed";
+        CLogger::error(os.str(), EXIT_MAIN_STATION);
+    }
 #else
-    char mode[3] = "rb";
+    CLogger::error("Station operation is not supported on this platform", EXIT_MAIN_STATION);
 #endif
-    
-    if ((f = fopen(fpath.c_str(), mode)) == NULL)
-	CLogger::error("Cannot open file for reading: " + fpath, EXIT_MAIN_FILE_INOUT);
+}
 
-    // Determine file size
-    fseek(f, 0, SEEK_END);
-    size = ftell(f);
-    fseek(f, 0, SEEK_SET);
-	
-    vector<uint8_t> data;
-    data.resize(size);
-    
-    size_t r = fread(data.data(), sizeof(uint8_t), size, f);
-    fclose(f);
+void
+opPlan(CUserConfig & uc)
+{
+    CImage image;
+    readDataFiles(uc.getWriteInputs(), image);
+    if (image.empty())
+        CLogger::error("Input file has no data", EXIT_MAIN_FILE_INOUT);
 
-    if (r != size)
-        CLogger::error("Cannot read from file: " + fpath, EXIT_MAIN_FILE_INOUT);
-    
-    return data;
+    // Without a model the MCU connected is identified and left ready for
+    // following operations, as by the ident operation
+    string name = uc.getPlanMcuName();
+    if (name.empty()) {
+        CTimelineSpan span("operation", "main");
+        sp->open(uc.getSerialPortName(), uc.getSerialSpeed());
+        CMcu mcu(*sp, uc.getMcuFrequency(), uc.getResetSequence());
+        name = mcu.ident();
+        mcu.init();
+    }
+    unique_ptr<IMcuSpecifics> specifics = CMcu::getMcuSpecificsByName(name);
+    if (!specifics)
+        CLogger::error("Unknown MCU model " + name, EXIT_USER_CONFIG);
+    if ((specifics->getName() == "ST10F168") && (uc.getMcuFrequency() == 0))
+        CLogger::error("Missing -f option for MCU " + specifics->getName(), EXIT_MCU);
+
+    CWritePlan plan(image, specifics->getBlockSizes(), specifics->getFlashSize(),
+                    uc.getWriteEraseWholeMemory());
+    CWriteEstimate estimate(*specifics, plan, uc.getWriteCheckByRead(), uc.getSerialSpeed(),
+                            uc.getMcuFrequency(), uc.isPipelineSet());
+    if (!uc.getPlanProfileFilename().empty())
+        estimate.loadProfile(uc.getPlanProfileFilename());
+    estimate.print();
 }
 
 void
-writeDataFile(const string fpath, vector<uint8_t> data)
+readDataFiles(const list<write_input_t> & inputs, CImage & image)
 {
-    FILE *out;
-#ifdef UNIX
-    char mode[3] = "w";
-#else
-    char mode[3] = "wb";
-#endif
-    
-    if ((out = fopen(fpath.c_str(), mode)) == NULL) {
-        ostringstream os;
-        os << "Cannot open file for writing: " << fpath << ": " << strerror(errno);
-	CLogger::error(os.str(), EXIT_MAIN_FILE_INOUT);
+    list<write_input_t>::const_iterator it;
+
+    // Each file is read separately to name the one with overlapping data
+    for (it = inputs.begin(); it != inputs.end(); ++it) {
+        CImage part;
+        uint32_t a;
+
+        readDataFile(*it, part);
+        if (image.overlaps(part, a)) {
+            ostringstream os;
+            os << "Data of file " << it->fname << " at address " << CLogger::decToHex(a);
+            os << " overlap data of previous files";
+            CLogger::error(os.str(), EXIT_MAIN_FILE_INOUT);
+        }
+        image.merge(part);
     }
+}
 
-    size_t r = fwrite(data.data(), sizeof(uint8_t), data.size(), out);
-    fclose(out);
+void
+readDataFile(const write_input_t & input, CImage & image)
+{
+    const string & fpath = input.fname;
+
+    // Format of standard input is recognized by its first character
+    bool isHex = CHexFile::hasHexExtension(fpath);
+    bool isSrec = CSrecFile::hasSrecExtension(fpath);
+    if (!fpath.compare("-")) {
+        int c = getc(stdin);
+        ungetc(c, stdin);
+        isHex = (c == ':');
+        isSrec = (c == 'S');
+    }
+
+    // Records carry their own addresses
+    if ((isHex || isSrec) && input.hasAddress)
+        CLogger::error("Address can not be given for file with records: " + fpath, EXIT_USER_CONFIG);
+
+    if (isHex) {
+        CHexFile hex(fpath);
+        hex.read(image);
+        return;
+    }
+    if (isSrec) {
+        CSrecFile srec(fpath);
+        srec.read(image);
+        return;
+    }
 
-    if (r != data.size())
-	CLogger::error("Cannot write to file: " + fpath, EXIT_MAIN_FILE_INOUT);
+    // Binary file holds data from address 0 unless address is given
+    image.addData(input.address, unique_ptr<CFileMapping>(new CFileMapping(fpath)));
 }
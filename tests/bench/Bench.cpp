@@ -0,0 +1,587 @@
+// Benchmark of the host code. Each scenario runs a complete session, from
+// the zero byte to the last block, against the simulator served in another
+// thread over a socket pair. Nothing is waited for: erase and program time
+// of the simulator is only counted and the line is modelled from the bytes
+// passed in both directions, so all metrics but CPU time are exact. Writes
+// go through the write session of the program. CPU time is the minimum of
+// several repetitions of the scenario.
+//
+//   bench [-u] [-s SPEED] BASELINE [SCENARIO]...
+//
+// Measured metrics are compared with BASELINE, the program fails when one
+// of them exceeds its limit. With -u the baseline is updated instead.
+
+#include "Simulator.hpp"
+#include "Mcu.hpp"
+#include "Logger.hpp"
+#include "ExitException.hpp"
+#include "ExitCodes.hpp"
+#include "WriteSession.hpp"
+#include "FileMapping.hpp"
+#include "Verifier.hpp"
+#include "BlockLayout.hpp"
+
+#include <unistd.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <poll.h>
+#include <sys/socket.h>
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <map>
+#include <thread>
+
+using std::cout;
+using std::cerr;
+using std::endl;
+using std::map;
+using std::ifstream;
+using std::ofstream;
+using std::ostringstream;
+using std::unique_ptr;
+
+#define BENCH_MODEL          "st10f269"
+#define BENCH_SPEED          230400
+// Modelled erase time of one block and program time of one word
+#define BENCH_ERASE_TIME     800   // ms
+#define BENCH_PROGRAM_TIME   16    // us
+#define BENCH_REPETITIONS    5
+
+// Allowed increase over the baseline. Counts and modelled time are exact,
+// CPU time varies with the machine and its load.
+#define LIMIT_EXACT_PERCENT  5
+#define LIMIT_CPU_PERCENT    50
+#define LIMIT_CPU_SLACK      1000  // us
+
+typedef struct {
+    uint64_t bytesOut;
+    uint64_t bytesIn;
+    uint64_t calls;       // Calls of the port, each is a system call of a real port
+    uint64_t cpuUs;       // CPU time of the host thread
+    uint64_t modelledUs;  // Line time of all bytes plus erase and program time
+} metrics_t;
+
+// Serial port on one end of a socket pair. A read waits for all requested
+// data, so the number of calls does not depend on scheduling.
+class CSerialPortBench : public CSerialPort {
+private:
+    int mFd;
+    uint64_t mBytesOut;
+    uint64_t mBytesIn;
+    uint64_t mCalls;
+
+    bool waitForInput(int timeoutMs)
+    {
+        struct pollfd p = { mFd, POLLIN, 0 };
+        int r;
+        do {
+            r = poll(&p, 1, timeoutMs);
+        } while ((r < 0) && (errno == EINTR));
+        return r > 0;
+    }
+
+    ssize_t readSingle(uint8_t *data, int data_length)
+    {
+        ++mCalls;
+        int i = 0;
+        while ((i < data_length) && waitForInput(mReadTimeoutMs)) {
+            ssize_t r = ::read(mFd, data + i, data_length - i);
+            if (r <= 0)
+                CLogger::error("Simulator closed the line", EXIT_SERIAL_PORT);
+            i += r;
+        }
+        mBytesIn += i;
+        return i;
+    }
+
+    ssize_t writeSingle(const uint8_t *data, int data_length)
+    {
+        ++mCalls;
+        ssize_t w = ::write(mFd, data, data_length);
+        if (w <= 0)
+            CLogger::error("Simulator closed the line", EXIT_SERIAL_PORT);
+        mBytesOut += w;
+        return w;
+    }
+
+    ssize_t readAvailable(uint8_t *data, int data_length, int timeoutMs)
+    {
+        ++mCalls;
+        if (!waitForInput(timeoutMs))
+            return 0;
+        ssize_t r = ::read(mFd, data, data_length);
+        if (r <= 0)
+            CLogger::error("Simulator closed the line", EXIT_SERIAL_PORT);
+        mBytesIn += r;
+        return r;
+    }
+public:
+    CSerialPortBench(int fd) : mFd(fd), mBytesOut(0), mBytesIn(0), mCalls(0) { ; };
+
+    void open(string portName, string speed) { ; };
+    string getSpeeds(string portName) { return ""; };
+    void close() { ; };
+    void setModemLine(int line, bool state) { ; };
+
+    void flushInput()
+    {
+        uint8_t b[256];
+        ++mCalls;
+        while (recv(mFd, b, sizeof(b), MSG_DONTWAIT) > 0)
+            ++mCalls;
+    }
+
+    void getMetrics(metrics_t & m) const
+    {
+        m.bytesOut = mBytesOut;
+        m.bytesIn = mBytesIn;
+        m.calls = mCalls;
+    }
+};
+
+// -----------------------------------------------------------------------------
+//  Scenarios
+// -----------------------------------------------------------------------------
+
+static vector<uint8_t>
+pattern(uint32_t length)
+{
+    vector<uint8_t> data(length);
+    for (uint32_t i = 0; i < length; ++i)
+        data[i] = (uint8_t) (i * 7 + (i >> 8));
+    return data;
+}
+
+static void
+readData(CMcu & mcu, uint32_t length)
+{
+    vector<uint8_t> data = mcu.read(length, false);
+    if (data.size() != length)
+        CLogger::error("Read returned wrong length", EXIT_SERIAL_PORT);
+}
+
+// Options of a plain write operation
+static write_options_t
+writeOptions()
+{
+    write_options_t o;
+    o.eraseWholeMemory = false;
+    o.checkByRead = false;
+    o.avoidErase = false;
+    o.skipBlank = false;
+    o.repairAttempts = 0;
+    o.verifyAbortAfter = 0;
+    o.serialSpeed = std::to_string(BENCH_SPEED);
+    o.pipelined = false;
+    return o;
+}
+
+// Temporary file with the pattern, opened for reading
+static FILE *
+patternFile(uint32_t length, string & path)
+{
+    char name[] = "/tmp/benchXXXXXX";
+    int fd = mkstemp(name);
+    if (fd == -1)
+        CLogger::error("Cannot create temporary file", EXIT_MAIN_FILE_INOUT);
+    path = name;
+    FILE *f = fdopen(fd, "w+b");
+    vector<uint8_t> data = pattern(length);
+    if ((f == 0) || (fwrite(data.data(), 1, length, f) != length) || (fflush(f) != 0)) {
+        unlink(name);
+        CLogger::error("Cannot write temporary file", EXIT_MAIN_FILE_INOUT);
+    }
+    rewind(f);
+    return f;
+}
+
+// Pattern mapped from a file, as a raw binary input file of the write
+// operation
+static void
+mapPattern(uint32_t length, CImage & image)
+{
+    string path;
+    FILE *f = patternFile(length, path);
+    try {
+        image.addData(0, unique_ptr<CFileMapping>(new CFileMapping(path)));
+    } catch (CExitException & e) {
+        fclose(f);
+        unlink(path.c_str());
+        throw;
+    }
+    fclose(f);
+    unlink(path.c_str());
+}
+
+static void
+writeFile(CMcu & mcu, uint32_t length, const write_options_t & options, const CImage & patches)
+{
+    CImage image;
+    mapPattern(length, image);
+    CWriteSession session(mcu, options, false);
+    session.writeImage(image, patches);
+}
+
+static void
+writeData(CMcu & mcu, uint32_t length)
+{
+    writeFile(mcu, length, writeOptions(), CImage());
+}
+
+static void read1B(CMcu & mcu) { readData(mcu, 1); }
+static void readOdd(CMcu & mcu) { readData(mcu, 100003); }
+static void read16K(CMcu & mcu) { readData(mcu, 16 * 1024); }
+static void read64K(CMcu & mcu) { readData(mcu, 64 * 1024); }
+static void read256K(CMcu & mcu) { readData(mcu, 256 * 1024); }
+static void write1B(CMcu & mcu) { writeData(mcu, 1); }
+static void writeOdd(CMcu & mcu) { writeData(mcu, 100003); }
+static void write16K(CMcu & mcu) { writeData(mcu, 16 * 1024); }
+static void write64K(CMcu & mcu) { writeData(mcu, 64 * 1024); }
+static void write256K(CMcu & mcu) { writeData(mcu, 256 * 1024); }
+
+// Small extents in distant blocks, blocks between them are read back
+static void
+writeSparse(CMcu & mcu)
+{
+    vector<uint8_t> data = pattern(3000);
+    CImage image;
+    image.addData(0x100, data.data(), 100);
+    image.addData(0x9000, data.data(), 3000);
+    image.addData(0x31000, data.data(), 500);
+    CWriteSession session(mcu, writeOptions(), false);
+    session.writeImage(image, CImage());
+}
+
+// Patches in two blocks are written over the file data
+static void
+writePatched(CMcu & mcu)
+{
+    const uint8_t serial[] = { 0x12, 0x34, 0x56, 0x78 };
+    CImage patches;
+    patches.addData(0x10, serial, sizeof(serial));
+    patches.addData(0x8000, serial, sizeof(serial));
+    writeFile(mcu, 64 * 1024, writeOptions(), patches);
+}
+
+// Written data are read back and compared
+static void
+writeChecked(CMcu & mcu)
+{
+    write_options_t o = writeOptions();
+    o.checkByRead = true;
+    writeFile(mcu, 64 * 1024, o, CImage());
+}
+
+// Stream of known length, as write -n from standard input
+static void
+writeStream(CMcu & mcu)
+{
+    string path;
+    FILE *f = patternFile(64 * 1024, path);
+    unlink(path.c_str());
+    try {
+        CWriteSession session(mcu, writeOptions(), false);
+        session.writeStream(f, "stream", 64 * 1024, CImage());
+    } catch (CExitException & e) {
+        fclose(f);
+        throw;
+    }
+    fclose(f);
+}
+
+static void
+eraseChip(CMcu & mcu)
+{
+    mcu.erase();
+}
+
+static void
+eraseBlocks(CMcu & mcu)
+{
+    mcu.erase(list<unsigned int>({ 0, 1, 2, 3 }));
+}
+
+// Simulated memory starts erased, it matches erased data
+static void
+verify64K(CMcu & mcu)
+{
+    vector<uint8_t> expected(64 * 1024, 0xFF);
+    CMemorySource source(expected.data(), expected.size());
+    CBlockLayout layout(mcu.getBlockSizes());
+    CVerifier verifier(source, layout, 0);
+    mcu.read(expected.size(), verifier, false);
+    if (verifier.hasMismatch())
+        CLogger::error("Verification of erased memory failed", EXIT_SERIAL_PORT);
+}
+
+typedef struct {
+    const char *name;
+    void (*run)(CMcu & mcu);
+} scenario_t;
+
+static const scenario_t scenarios[] = {
+    { "read_1B", read1B },
+    { "read_100003B", readOdd },
+    { "read_16K", read16K },
+    { "read_64K", read64K },
+    { "read_256K", read256K },
+    { "write_1B", write1B },
+    { "write_100003B", writeOdd },
+    { "write_16K", write16K },
+    { "write_64K", write64K },
+    { "write_256K", write256K },
+    { "write_sparse", writeSparse },
+    { "write_patched", writePatched },
+    { "write_checked", writeChecked },
+    { "write_stream", writeStream },
+    { "erase_chip", eraseChip },
+    { "erase_blocks", eraseBlocks },
+    { "verify_64K", verify64K },
+};
+
+static uint64_t
+getThreadCpuUs()
+{
+    struct timespec t;
+    clock_gettime(CLOCK_THREAD_CPUTIME_ID, &t);
+    return (uint64_t) t.tv_sec * 1000000 + t.tv_nsec / 1000;
+}
+
+// Returns false when the session failed
+static bool
+runScenario(const scenario_t & s, int speed, metrics_t & m)
+{
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0) {
+        cerr << "bench: Cannot create socket pair: " << strerror(errno) << endl;
+        return false;
+    }
+
+    sim_model_t model;
+    CSimulator::findModel(BENCH_MODEL, model);
+    CSimulator sim(fds[1], -1, model);
+    sim.setVirtualTime(true);
+    sim.setEraseTime(BENCH_ERASE_TIME);
+    sim.setProgramTime(BENCH_PROGRAM_TIME);
+    std::thread simThread(&CSimulator::run, &sim);
+
+    CSerialPortBench port(fds[0]);
+    bool ok = true;
+    uint64_t cpu = getThreadCpuUs();
+    try {
+        CMcu mcu(port, 0);
+        s.run(mcu);
+    } catch (CExitException & e) {
+        cerr << "bench: " << s.name << ": " << e.what() << endl;
+        ok = false;
+    }
+    m.cpuUs = getThreadCpuUs() - cpu;
+
+    // Simulator ends when it finds the line closed
+    close(fds[0]);
+    simThread.join();
+    close(fds[1]);
+
+    port.getMetrics(m);
+    m.modelledUs = (m.bytesOut + m.bytesIn) * 10 * 1000000 / speed + sim.getBusyTime().count();
+    return ok;
+}
+
+// -----------------------------------------------------------------------------
+//  Baseline
+// -----------------------------------------------------------------------------
+
+typedef map<string, map<string, uint64_t> > baseline_t;
+
+static const char * const metricNames[] = {
+    "bytes_out", "bytes_in", "calls", "cpu_us", "modelled_us"
+};
+
+static map<string, uint64_t>
+toMap(const metrics_t & m)
+{
+    map<string, uint64_t> r;
+    r["bytes_out"] = m.bytesOut;
+    r["bytes_in"] = m.bytesIn;
+    r["calls"] = m.calls;
+    r["cpu_us"] = m.cpuUs;
+    r["modelled_us"] = m.modelledUs;
+    return r;
+}
+
+// Lines are "scenario metric value", # starts a comment
+static bool
+loadBaseline(const string & fileName, baseline_t & baseline)
+{
+    ifstream f(fileName.c_str());
+    if (!f)
+        return false;
+    string line;
+    while (std::getline(f, line)) {
+        if (line.empty() || (line[0] == '#'))
+            continue;
+        std::istringstream is(line);
+        string scenario, metric;
+        uint64_t value;
+        if (is >> scenario >> metric >> value)
+            baseline[scenario][metric] = value;
+    }
+    return true;
+}
+
+static bool
+saveBaseline(const string & fileName, const baseline_t & baseline)
+{
+    ofstream f(fileName.c_str());
+    f << "# Baseline of the bench tests: scenario metric value" << endl
+      << "# Update with \"make bench_baseline\" after a reviewed change of performance" << endl;
+    for (const scenario_t & s : scenarios) {
+        baseline_t::const_iterator it = baseline.find(s.name);
+        if (it == baseline.end())
+            continue;
+        for (const char *m : metricNames) {
+            map<string, uint64_t>::const_iterator v = it->second.find(m);
+            if (v != it->second.end())
+                f << s.name << " " << m << " " << v->second << endl;
+        }
+    }
+    f.close();
+    return !f.fail();
+}
+
+static uint64_t
+getLimit(const string & metric, uint64_t base)
+{
+    if (metric == "cpu_us")
+        return base + base * LIMIT_CPU_PERCENT / 100 + LIMIT_CPU_SLACK;
+    return base + base * LIMIT_EXACT_PERCENT / 100;
+}
+
+// Print comparison of measured metrics with the baseline, returns false
+// when a metric exceeds its limit
+static bool
+check(const string & scenario, const map<string, uint64_t> & measured, const baseline_t & baseline)
+{
+    baseline_t::const_iterator b = baseline.find(scenario);
+    if (b == baseline.end()) {
+        cerr << "bench: Scenario " << scenario << " has no baseline" << endl;
+        return false;
+    }
+    bool ok = true;
+    for (const char *m : metricNames) {
+        uint64_t value = measured.at(m);
+        map<string, uint64_t>::const_iterator v = b->second.find(m);
+        if (v == b->second.end()) {
+            cerr << "bench: Metric " << m << " of scenario " << scenario << " has no baseline" << endl;
+            ok = false;
+            continue;
+        }
+        uint64_t limit = getLimit(m, v->second);
+        cout << std::left << std::setw(16) << scenario << std::setw(12) << m
+             << std::right << std::setw(10) << value << "  baseline " << std::setw(10) << v->second
+             << "  limit " << std::setw(10) << limit;
+        if (value > limit) {
+            cout << "  FAILED";
+            ok = false;
+        } else if ((m != string("cpu_us")) && (value < v->second)) {
+            cout << "  better, update the baseline";
+        }
+        cout << endl;
+    }
+    return ok;
+}
+
+static void
+usage()
+{
+    cerr << "Usage: bench [-u] [-s SPEED] BASELINE [SCENARIO]..." << endl
+         << "  -u        Update the baseline with measured metrics" << endl
+         << "  -s SPEED  Modelled line speed, default " << BENCH_SPEED << endl
+         << "Scenarios:";
+    for (const scenario_t & s : scenarios)
+        cerr << " " << s.name;
+    cerr << endl;
+    exit(2);
+}
+
+int
+main(int argc, char **argv)
+{
+    bool update = false;
+    int speed = BENCH_SPEED;
+    int i;
+
+    for (i = 1; (i < argc) && (argv[i][0] == '-'); ++i) {
+        string a = argv[i];
+        if (a == "-u") {
+            update = true;
+        } else if ((a == "-s") && (i + 1 < argc)) {
+            char *e;
+            speed = strtol(argv[++i], &e, 10);
+            if ((*e != '\0') || (speed <= 0))
+                usage();
+        } else {
+            usage();
+        }
+    }
+    if (i == argc)
+        usage();
+    string baselineFile = argv[i++];
+
+    list<const scenario_t *> selected;
+    for (; i < argc; ++i) {
+        const scenario_t *found = 0;
+        for (const scenario_t & s : scenarios)
+            if (s.name == string(argv[i]))
+                found = &s;
+        if (found == 0)
+            usage();
+        selected.push_back(found);
+    }
+    if (selected.empty())
+        for (const scenario_t & s : scenarios)
+            selected.push_back(&s);
+
+    // Writes of the simulator to the closed line must not kill the program
+    signal(SIGPIPE, SIG_IGN);
+
+    baseline_t baseline;
+    if (!loadBaseline(baselineFile, baseline) && !update) {
+        cerr << "bench: Cannot read baseline " << baselineFile << endl;
+        return EXIT_MAIN_FILE_INOUT;
+    }
+
+    bool ok = true;
+    for (const scenario_t *s : selected) {
+        // Counts are the same in each repetition, the least CPU time is
+        // the one least disturbed by other load of the machine
+        metrics_t m;
+        bool run = true;
+        for (int r = 0; run && (r < BENCH_REPETITIONS); ++r) {
+            metrics_t rm;
+            run = runScenario(*s, speed, rm);
+            if ((r == 0) || (rm.cpuUs < m.cpuUs))
+                m = rm;
+        }
+        if (!run) {
+            ok = false;
+            continue;
+        }
+        if (update)
+            baseline[s->name] = toMap(m);
+        else if (!check(s->name, toMap(m), baseline))
+            ok = false;
+    }
+
+    if (update && !saveBaseline(baselineFile, baseline)) {
+        cerr << "bench: Cannot write baseline " << baselineFile << endl;
+        return EXIT_MAIN_FILE_INOUT;
+    }
+    return ok ? 0 : 1;
+}
@@ -1,4 +1,11 @@
+macro (M_SET_PORT_OPTION)
+  if (NOT "${SerialPortName}" STREQUAL "")
+    set (CONFIG_OPTIONS "${CONFIG_OPTIONS} -p ${SerialPortName}")
+  endif ()
+endmacro ()
+
 macro (M_SET_CONFIG_OPTIONS)
+  m_set_port_option ()
   if (${SerialPortSpeed})
     set (CONFIG_OPTIONS "${CONFIG_OPTIONS} -s ${SerialPortSpeed}")
   endif ()
@@ -10,11 +17,13 @@ macro (M_SET_CONFIG_OPTIONS)
   endif ()
 endmacro ()
 
+# TestLauncher is a command prefix which runs the test, e.g. a simulator
 macro (M_ADD_TEST SCRIPT)
   add_test(NAME ${TestNamespace}${NAME}
     CONFIGURATIONS ${TestConfigurations}
-    COMMAND ${CMAKE_COMMAND}
+    COMMAND ${TestLauncher} ${CMAKE_COMMAND}
     -DTestFunctions=${CMAKE_SOURCE_DIR}/tests/functions.cmake
+    -DTestProgram=$<TARGET_FILE:main>
     -DTestArgs=${ARGS}
     -DTestConfigOptions=${CONFIG_OPTIONS}
     -DTestExitCode=${EXITCODE}
@@ -22,10 +31,26 @@ macro (M_ADD_TEST SCRIPT)
     -DTestFile=${FILE}
     -P ${SCRIPT}
     )
+  # Tests sharing one MCU must not run in parallel and they depend on
+  # memory content left by previous tests
+  if (NOT "${TestResourceLock}" STREQUAL "")
+    get_property (PREVIOUS GLOBAL PROPERTY ${TestResourceLock}_LAST)
+    set_tests_properties (${TestNamespace}${NAME} PROPERTIES
+      RESOURCE_LOCK ${TestResourceLock} DEPENDS "${PREVIOUS}")
+    set_property (GLOBAL PROPERTY ${TestResourceLock}_LAST ${TestNamespace}${NAME})
+  endif ()
+  # Files read back by tests of different MCUs must not collide
+  if (NOT "${TestWorkingDirectory}" STREQUAL "")
+    set_tests_properties (${TestNamespace}${NAME} PROPERTIES WORKING_DIRECTORY ${TestWorkingDirectory})
+  endif ()
 endmacro ()
 
 
 function (ADD_WITHOUT_CONFIG_TEST NAME ARGS EXITCODE)
+  # Port is given only to an operation
+  if (NOT "${ARGS}" STREQUAL "")
+    m_set_port_option ()
+  endif ()
   m_add_test (${CMAKE_SOURCE_DIR}/tests/other_operations.cmake)
 endfunction ()
 
@@ -56,7 +81,7 @@ endfunction ()
 function (EXEC_TEST ARGS EXITCODE)
   string (REPLACE " " ";" ARGS_LIST "${ARGS}")
   execute_process (
-    COMMAND ${CMAKE_BINARY_DIR}/main ${ARGS_LIST}
+    COMMAND ${TestProgram} ${ARGS_LIST}
     RESULT_VARIABLE MAIN_RESULT
     TIMEOUT 120
     )
@@ -0,0 +1,416 @@
+// Tests of host code talking to serial ports which are not the MCU: a port
+// recording what the host does with it and an in-process RFC 2217 server.
+//
+//   porttest CASE
+//
+// Exit code is 0 when all checks of the case pass, failed checks are
+// printed.
+
+#include "Mcu.hpp"
+#include "ResetSequence.hpp"
+#include "SerialPortTcp.hpp"
+#include "Logger.hpp"
+#include "ExitException.hpp"
+#include "ExitCodes.hpp"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <chrono>
+#include <thread>
+
+using std::cout;
+using std::cerr;
+using std::endl;
+using std::vector;
+using std::ostringstream;
+using std::thread;
+namespace chrono = std::chrono;
+
+#define BOOTSTRAP_ACK 0xD5
+
+static int failures = 0;
+
+static void
+check(bool ok, const string & what)
+{
+    if (!ok) {
+        cerr << "FAILED: " << what << endl;
+        failures++;
+    }
+}
+
+static string
+join(const vector<string> & v)
+{
+    ostringstream os;
+    for (size_t i = 0; i < v.size(); ++i)
+        os << ((i == 0) ? "" : " ") << v[i];
+    return os.str();
+}
+
+// -----------------------------------------------------------------------------
+//  Reset sequence
+// -----------------------------------------------------------------------------
+
+// Port recording modem line changes and pings. MCU answers the ping only
+// after the given number of pings went unanswered.
+class CSerialPortMock : public CSerialPort {
+private:
+    int mSilentPings;
+    int mPings;
+
+    void event(const string & e)
+    {
+        mEvents.push_back(e);
+        mTimes.push_back(chrono::steady_clock::now());
+    }
+
+    ssize_t readSingle(uint8_t *data, int data_length)
+    {
+        event("read");
+        return 0;
+    }
+
+    ssize_t writeSingle(const uint8_t *data, int data_length)
+    {
+        for (int i = 0; i < data_length; ++i)
+            event("write " + CLogger::decToHex(data[i]));
+        return data_length;
+    }
+
+    ssize_t readAvailable(uint8_t *data, int data_length, int timeoutMs)
+    {
+        if (++mPings <= mSilentPings) {
+            event("timeout");
+            return 0;
+        }
+        event("ack");
+        data[0] = BOOTSTRAP_ACK;
+        return 1;
+    }
+public:
+    vector<string> mEvents;
+    vector<chrono::steady_clock::time_point> mTimes;
+
+    CSerialPortMock(int silentPings) : mSilentPings(silentPings), mPings(0) { ; };
+
+    void open(string portName, string speed) { ; };
+    string getSpeeds(string portName) { return ""; };
+    void close() { ; };
+    void flushInput() { event("flush"); };
+
+    void setModemLine(int line, bool state)
+    {
+        event(string((line == SERIAL_LINE_DTR) ? "dtr" : "rts") + (state ? "=1" : "=0"));
+    }
+
+    // Time between events i and j
+    long getMs(size_t i, size_t j) const
+    {
+        return chrono::duration_cast<chrono::milliseconds>(mTimes[j] - mTimes[i]).count();
+    }
+};
+
+#define RESET_SPEC      "dtr=1,rts=1,50,rts=0,100,dtr=0"
+#define RESET_EVENTS    "dtr=1 rts=1 rts=0 dtr=0"
+#define PING_EVENTS     "flush write 0x0"
+
+// Returns exit code of the connect, 0 when it succeeded
+static int
+connect(CSerialPortMock & port)
+{
+    CResetSequence reset(RESET_SPEC);
+    try {
+        CMcu mcu(port, 0, &reset);
+    } catch (CExitException & e) {
+        return e.getReturnValue();
+    }
+    return 0;
+}
+
+static void
+checkDelays(const CSerialPortMock & port, size_t first)
+{
+    // Lines change in order, delays lie between them
+    check(port.getMs(first + 1, first + 2) >= 50, "50 ms between rts=1 and rts=0");
+    check(port.getMs(first + 2, first + 3) >= 100, "100 ms between rts=0 and dtr=0");
+    check(port.getMs(first, first + 1) < 50, "no delay between dtr=1 and rts=1");
+}
+
+static void
+testResetSequence()
+{
+    CSerialPortMock port(0);
+    check(connect(port) == 0, "connect after reset");
+    string e = join(port.mEvents);
+    check(e == RESET_EVENTS " " PING_EVENTS " ack", "events '" + e + "'");
+    if (port.mEvents.size() >= 4)
+        checkDelays(port, 0);
+}
+
+static void
+testResetRetry()
+{
+    CSerialPortMock port(1);
+    check(connect(port) == 0, "connect after the second reset");
+    string e = join(port.mEvents);
+    check(e == RESET_EVENTS " " PING_EVENTS " timeout " RESET_EVENTS " " PING_EVENTS " ack",
+          "events '" + e + "'");
+    if (port.mEvents.size() >= 11)
+        checkDelays(port, 7);
+}
+
+static void
+testResetNoAnswer()
+{
+    CSerialPortMock port(1000);
+    int r = connect(port);
+    check(r == EXIT_SERIAL_PORT, "exit code " + std::to_string(r) + " when MCU does not answer");
+    // Reset is repeated only once
+    string e = join(port.mEvents);
+    check(e == RESET_EVENTS " " PING_EVENTS " timeout " RESET_EVENTS " " PING_EVENTS " timeout",
+          "events '" + e + "'");
+}
+
+// -----------------------------------------------------------------------------
+//  RFC 2217
+// -----------------------------------------------------------------------------
+
+#define IAC     255
+#define DO      253
+#define WILL    251
+#define SB      250
+#define SE      240
+#define COMPORT 44
+// Server to client notification, RFC 2217
+#define COMPORT_NOTIFY_MODEMSTATE 107
+
+// Terminal server serving one connection. It records COM-PORT-OPTION
+// commands and data received from the client and echoes data back. Echo
+// is preceded by a Telnet option and a notification the client has to
+// skip.
+class CRfc2217Server {
+private:
+    int mListenFd;
+    uint16_t mPort;
+    thread mThread;
+
+    void sendEscaped(int fd, const vector<uint8_t> & data)
+    {
+        vector<uint8_t> e;
+        for (uint8_t b : data) {
+            e.push_back(b);
+            if (b == IAC)
+                e.push_back(IAC);
+        }
+        send(fd, e.data(), e.size(), MSG_NOSIGNAL);
+    }
+
+    void command(const vector<uint8_t> & sb)
+    {
+        static const char *names[] = { "", "baudrate", "datasize", "parity", "stopsize", "control" };
+        ostringstream os;
+        if ((sb.size() < 2) || (sb[0] != COMPORT)) {
+            os << "unknown";
+        } else if (sb[1] == 12) {
+            os << "purge";
+        } else if (sb[1] < 6) {
+            os << names[sb[1]];
+        } else {
+            os << "command " << (int) sb[1];
+        }
+        if ((sb.size() == 6) && (sb[1] == 1))
+            os << " " << (((uint32_t) sb[2] << 24) | (sb[3] << 16) | (sb[4] << 8) | sb[5]);
+        else
+            for (size_t i = 2; i < sb.size(); ++i)
+                os << " " << (int) sb[i];
+        mCommands.push_back(os.str());
+    }
+
+    void serve()
+    {
+        int fd = accept(mListenFd, NULL, NULL);
+        if (fd == -1)
+            return;
+        // Telnet decoder as in RFC 854, 0 data, 1 IAC, 2 option, 3 SB,
+        // 4 IAC in SB
+        int state = 0;
+        vector<uint8_t> sb;
+        bool first = true;
+        uint8_t buffer[256];
+        ssize_t r;
+        while ((r = recv(fd, buffer, sizeof(buffer), 0)) > 0) {
+            vector<uint8_t> data;
+            mRaw.insert(mRaw.end(), buffer, buffer + r);
+            for (ssize_t i = 0; i < r; ++i) {
+                uint8_t b = buffer[i];
+                switch (state) {
+                case 0:
+                    if (b == IAC)
+                        state = 1;
+                    else
+                        data.push_back(b);
+                    break;
+                case 1:
+                    if (b == IAC) {
+                        data.push_back(b);
+                        state = 0;
+                    } else if (b == SB) {
+                        sb.clear();
+                        state = 3;
+                    } else {
+                        state = (b >= WILL) ? 2 : 0;
+                    }
+                    break;
+                case 2:
+                    state = 0;
+                    break;
+                case 3:
+                    if (b == IAC)
+                        state = 4;
+                    else
+                        sb.push_back(b);
+                    break;
+                case 4:
+                    if (b == SE) {
+                        command(sb);
+                        state = 0;
+                    } else {
+                        sb.push_back(b);
+                        state = 3;
+                    }
+                    break;
+                }
+            }
+            if (data.empty())
+                continue;
+            mData.insert(mData.end(), data.begin(), data.end());
+            if (first) {
+                const uint8_t c[] = { IAC, DO, COMPORT,
+                                      IAC, SB, COMPORT, COMPORT_NOTIFY_MODEMSTATE, IAC, IAC, IAC, SE };
+                send(fd, c, sizeof(c), MSG_NOSIGNAL);
+                first = false;
+            }
+            sendEscaped(fd, data);
+        }
+        ::close(fd);
+    }
+public:
+    vector<string> mCommands;
+    vector<uint8_t> mData;
+    vector<uint8_t> mRaw;
+
+    CRfc2217Server() : mPort(0)
+    {
+        struct sockaddr_in a;
+        socklen_t l = sizeof(a);
+        memset(&a, 0, sizeof(a));
+        a.sin_family = AF_INET;
+        a.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        mListenFd = socket(AF_INET, SOCK_STREAM, 0);
+        if ((mListenFd == -1) || (bind(mListenFd, (struct sockaddr *) &a, sizeof(a)) == -1)
+            || (listen(mListenFd, 1) == -1) || (getsockname(mListenFd, (struct sockaddr *) &a, &l) == -1)) {
+            cerr << "Cannot listen on loopback: " << strerror(errno) << endl;
+            exit(2);
+        }
+        mPort = ntohs(a.sin_port);
+        mThread = thread(&CRfc2217Server::serve, this);
+    }
+
+    ~CRfc2217Server()
+    {
+        if (mThread.joinable())
+            mThread.join();
+        ::close(mListenFd);
+    }
+
+    string getPortName() const
+    {
+        return SERIAL_PORT_RFC2217_PREFIX "127.0.0.1:" + std::to_string(mPort);
+    }
+
+    // Waits until the client closed the connection
+    void join()
+    {
+        mThread.join();
+    }
+};
+
+// Number of escaped 0xFF pairs in data
+static unsigned int
+countEscaped(const vector<uint8_t> & data)
+{
+    unsigned int n = 0;
+    for (size_t i = 0; i + 1 < data.size(); ++i) {
+        if ((data[i] == IAC) && (data[i + 1] == IAC)) {
+            n++;
+            i++;
+        }
+    }
+    return n;
+}
+
+static void
+testRfc2217()
+{
+    CRfc2217Server server;
+    CSerialPortTcp port;
+    const vector<uint8_t> data = { 0x00, 0xFF, 0x55, 0xFF, 0xFF, 0xAB };
+    vector<uint8_t> echo(data.size());
+
+    port.open(server.getPortName(), "57600");
+    port.setModemLine(SERIAL_LINE_DTR, true);
+    port.setModemLine(SERIAL_LINE_RTS, false);
+    port.setModemLine(SERIAL_LINE_DTR | SERIAL_LINE_RTS, true);
+    port.flushInput();
+    port.write(data.data(), data.size(), data.size());
+    port.read(echo.data(), echo.size());
+    port.close();
+    server.join();
+
+    string c = join(server.mCommands);
+    check(c == "baudrate 57600 datasize 8 parity 1 stopsize 1 control 1"
+          " control 8 control 12 control 8 control 11 purge 1", "commands '" + c + "'");
+    // Data bytes 0xFF are doubled on the line and only there
+    check(server.mData == data, "data received by the server");
+    check(countEscaped(server.mRaw) == 3, "0xFF data bytes are escaped");
+    check(echo == data, "echo without Telnet commands and escapes");
+}
+
+typedef struct {
+    const char *name;
+    void (*run)();
+} test_case_t;
+
+static const test_case_t cases[] = {
+    { "reset_sequence", testResetSequence },
+    { "reset_retry", testResetRetry },
+    { "reset_no_answer", testResetNoAnswer },
+    { "rfc2217", testRfc2217 },
+};
+
+int
+main(int argc, char **argv)
+{
+    if (argc != 2) {
+        cerr << "Usage: porttest CASE" << endl;
+        return 2;
+    }
+    for (const test_case_t & c : cases) {
+        if (string(argv[1]) == c.name) {
+            c.run();
+            return (failures == 0) ? 0 : 1;
+        }
+    }
+    cerr << "porttest: Unknown case " << argv[1] << endl;
+    return 2;
+}
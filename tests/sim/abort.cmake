@@ -0,0 +1,17 @@
+# Verify aborted at the first difference ends without waiting for the rest
+# of memory. Line time of the whole memory is modelled, it is about 11 s.
+
+include (${SimFunctions})
+
+sim_exec ("write ${TestDataDir}/st10f269/write/random" 0)
+sim_modify_flash (${TestDataDir}/multi/16B.bin 0)
+
+set (SimOptions -t)
+string (TIMESTAMP START %s)
+sim_exec ("verify --abort-after 1 ${TestDataDir}/st10f269/write/random" 9)
+string (TIMESTAMP END %s)
+sim_expect_output ("Verification aborted after 1024 bytes")
+math (EXPR ELAPSED "${END} - ${START}")
+if (ELAPSED GREATER 5)
+  message (FATAL_ERROR "Aborted verify took ${ELAPSED} s")
+endif ()
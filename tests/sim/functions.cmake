@@ -0,0 +1,52 @@
+# Functions of simulator sessions. Every operation runs against its own
+# st10sim, flash content is kept in the state file between them.
+#
+# Variables: TestFunctions, TestProgram, Simulator, SimDir, TestDataDir
+
+include (${TestFunctions})
+
+set (SimMcu st10f269)
+set (SimSpeed 230400)
+set (SimState ${SimDir}/flash)
+
+file (REMOVE_RECURSE ${SimDir})
+file (MAKE_DIRECTORY ${SimDir})
+
+# Output of the program is returned in OUTPUT. SimOptions are passed to
+# the simulator.
+function (SIM_EXEC ARGS EXITCODE)
+  string (REPLACE " " ";" ARGS_LIST "${ARGS}")
+  execute_process (
+    COMMAND ${Simulator} -m ${SimMcu} -s ${SimState} -l ${SimDir}/tty ${SimOptions} --
+            ${TestProgram} ${ARGS_LIST} -p ${SimDir}/tty -s ${SimSpeed}
+    WORKING_DIRECTORY ${SimDir}
+    RESULT_VARIABLE MAIN_RESULT
+    OUTPUT_VARIABLE MAIN_OUTPUT
+    ERROR_VARIABLE MAIN_OUTPUT
+    TIMEOUT 120
+    )
+  message ("${MAIN_OUTPUT}")
+  if (NOT "${MAIN_RESULT}" STREQUAL "${EXITCODE}")
+    message (FATAL_ERROR "Unexpected exit code ${MAIN_RESULT} of '${ARGS}', expected ${EXITCODE}")
+  endif ()
+  set (OUTPUT "${MAIN_OUTPUT}" PARENT_SCOPE)
+endfunction ()
+
+# Copies content of FILE over the flash at OFFSET as if memory changed
+# behind the back of the programmer
+function (SIM_MODIFY_FLASH FILE OFFSET)
+  execute_process (
+    COMMAND dd if=${FILE} of=${SimState} bs=1 seek=${OFFSET} conv=notrunc
+    RESULT_VARIABLE DD_RESULT
+    OUTPUT_QUIET ERROR_QUIET
+    )
+  if (DD_RESULT)
+    message (FATAL_ERROR "Cannot modify flash state ${SimState}")
+  endif ()
+endfunction ()
+
+function (SIM_EXPECT_OUTPUT PATTERN)
+  if (NOT "${OUTPUT}" MATCHES "${PATTERN}")
+    message (FATAL_ERROR "Output does not match '${PATTERN}'")
+  endif ()
+endfunction ()
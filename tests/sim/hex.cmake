@@ -0,0 +1,14 @@
+# HEX file with an extended linear address record is written above 64 KiB
+# and verified
+
+include (${SimFunctions})
+
+set (HexFile ${TestDataDir}/hex/extended_address.hex)
+
+sim_exec ("write ${HexFile}" 0)
+sim_exec ("verify ${HexFile}" 0)
+# Data of the second record lie at 0x10010, not at 0x10
+file (READ ${SimState} FLASH OFFSET 65552 LIMIT 16 HEX)
+if (NOT "${FLASH}" STREQUAL "a0a1a2a3a4a5a6a7a8a9aaabacadaeaf")
+  message (FATAL_ERROR "Flash at 0x10010 contains ${FLASH}")
+endif ()
@@ -0,0 +1,9 @@
+# Files placed at their addresses are written in one pass, the gap between
+# them reads as erased memory
+
+include (${SimFunctions})
+
+sim_exec ("write ${TestDataDir}/st10f269/write/random" 0)
+sim_exec ("write ${TestDataDir}/multi/16B.bin ${TestDataDir}/st10f269/write/1B@0x20" 0)
+sim_exec ("read -n 33 read.bin" 0)
+compare_files (${SimDir}/read.bin ${TestDataDir}/multi/ok_merged)
@@ -0,0 +1,31 @@
+# Existing output file is replaced only by a complete read. Failure is
+# made by a recorded session which diverges after the file was opened.
+
+include (${SimFunctions})
+
+function (REPLAY_READ ARGS EXITCODE)
+  string (REPLACE " " ";" ARGS_LIST "${ARGS}")
+  execute_process (
+    COMMAND ${TestProgram} read -p replay://session.trc -s ${SimSpeed} ${ARGS_LIST}
+    WORKING_DIRECTORY ${SimDir}
+    RESULT_VARIABLE MAIN_RESULT
+    TIMEOUT 120
+    )
+  if (NOT "${MAIN_RESULT}" STREQUAL "${EXITCODE}")
+    message (FATAL_ERROR "Unexpected exit code ${MAIN_RESULT} of '${ARGS}', expected ${EXITCODE}")
+  endif ()
+endfunction ()
+
+sim_exec ("write ${TestDataDir}/st10f269/write/random" 0)
+sim_exec ("read --record session.trc -n 4096 read.bin" 0)
+file (COPY ${TestDataDir}/multi/16B.bin DESTINATION ${SimDir})
+
+replay_read ("-n 4094 16B.bin" 7)
+compare_files (${SimDir}/16B.bin ${TestDataDir}/multi/16B.bin)
+file (GLOB TEMP_FILES ${SimDir}/*.tmp)
+if (TEMP_FILES)
+  message (FATAL_ERROR "Temporary files left: ${TEMP_FILES}")
+endif ()
+
+replay_read ("-n 4096 16B.bin" 0)
+compare_files (${SimDir}/16B.bin ${SimDir}/read.bin)
@@ -0,0 +1,11 @@
+# Patches of hexadecimal bytes, file content and a counter are written over
+# data of the file and their values are printed
+
+include (${SimFunctions})
+
+sim_exec ("write ${TestDataDir}/multi/16B.bin --patch 0x1=DEADBEEF --patch 0x8=@${TestDataDir}/st10f269/write/1B --patch 0xC={0x1234}" 0)
+sim_expect_output ("Patch at 0x1: DEADBEEF")
+sim_expect_output ("Patch at 0x8: B3")
+sim_expect_output ("Patch at 0xC: 34120000")
+sim_exec ("read -n 16 read.bin" 0)
+compare_files (${SimDir}/read.bin ${TestDataDir}/multi/ok_patched)
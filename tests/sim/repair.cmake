@@ -0,0 +1,25 @@
+# Word which is not programmed by the first write is found by the check.
+# Only its block is erased and written again, then memory matches.
+
+include (${SimFunctions})
+
+set (Reference ${TestDataDir}/st10f269/write/random)
+# Word in block 3
+set (SimOptions -v -F 32784)
+
+sim_exec ("write -c ${Reference}" 4)
+sim_expect_output ("Block 3: 2 bytes differ in 1 ranges: 0x8010-0x8011")
+
+sim_exec ("write --repair 1 ${Reference}" 0)
+sim_expect_output ("Repairing blocks 3, attempt 1 of 1")
+sim_expect_output ("Repaired blocks 3")
+# Whole memory is erased for the write, only block 3 for the repair
+sim_expect_output ("Erased blocks 0,1,2,3,4,5,6\n.*Word at 32784 not programmed\n.*Erased blocks 3\n")
+string (REGEX MATCHALL "Erased blocks" ERASES "${OUTPUT}")
+list (LENGTH ERASES ERASE_COUNT)
+if (NOT ERASE_COUNT EQUAL 2)
+  message (FATAL_ERROR "Memory erased ${ERASE_COUNT} times, expected 2")
+endif ()
+
+set (SimOptions)
+sim_exec ("verify ${Reference}" 0)
@@ -0,0 +1,33 @@
+# Block programmed over by --avoid-erase and then repaired keeps content
+# of its part beyond the written data. Image equals memory up to 0x8000,
+# then clears bits of 16 bytes in block 3 which ends at 0xFFFF.
+
+include (${SimFunctions})
+
+set (Memory ${TestDataDir}/st10f269/write/random)
+
+function (COPY_BYTES FROM TO SEEK COUNT)
+  execute_process (
+    COMMAND dd if=${FROM} of=${TO} bs=16 seek=${SEEK} count=${COUNT} conv=notrunc
+    RESULT_VARIABLE DD_RESULT
+    OUTPUT_QUIET ERROR_QUIET
+    )
+  if (DD_RESULT)
+    message (FATAL_ERROR "Cannot write ${TO}")
+  endif ()
+endfunction ()
+
+copy_bytes (${Memory} ${SimDir}/image.bin 0 2048)
+copy_bytes (/dev/zero ${SimDir}/image.bin 2048 1)
+file (COPY ${Memory} DESTINATION ${SimDir})
+file (RENAME ${SimDir}/random ${SimDir}/expected.bin)
+copy_bytes (/dev/zero ${SimDir}/expected.bin 2048 1)
+
+sim_exec ("write ${Memory}" 0)
+# Word in the programmed part of block 3
+set (SimOptions -v -F 32776)
+sim_exec ("write --avoid-erase --repair 1 ${SimDir}/image.bin" 0)
+sim_expect_output ("Repaired blocks 3")
+
+set (SimOptions)
+sim_exec ("verify ${SimDir}/expected.bin" 0)
@@ -0,0 +1,13 @@
+# Blank block found by the check is not erased and the net saving is
+# printed. Check of the whole memory takes longer than its erase at the
+# serial speed of the simulator and it is not done.
+
+include (${SimFunctions})
+
+sim_exec ("write ${TestDataDir}/st10f269/write/random" 0)
+sim_exec ("erase -b 0" 0)
+sim_exec ("erase -b 0 --skip-blank" 0)
+sim_expect_output ("Blocks already blank: 0, about [0-9.]+ s saved by erase time skipped less [0-9.]+ s of blank check")
+
+sim_exec ("erase --skip-blank" 0)
+sim_expect_output ("Blank check skipped, reading takes about [0-9.]+ s, erase [0-9.]+ s")
@@ -0,0 +1,20 @@
+# Memory read into S-record files with 24 and 32 bit addresses is verified
+# against the memory it came from
+
+include (${SimFunctions})
+
+sim_exec ("write ${TestDataDir}/st10f269/write/24K_1B" 0)
+foreach (Ext s28 s37)
+  sim_exec ("read -n 24577 read.${Ext}" 0)
+  file (STRINGS ${SimDir}/read.${Ext} RECORDS)
+  list (GET RECORDS 1 RECORD)
+  string (SUBSTRING "${RECORD}" 0 2 TYPE)
+  if (NOT ((Ext STREQUAL "s28" AND TYPE STREQUAL "S2") OR (Ext STREQUAL "s37" AND TYPE STREQUAL "S3")))
+    message (FATAL_ERROR "File read.${Ext} contains ${TYPE} data records")
+  endif ()
+  sim_exec ("verify read.${Ext}" 0)
+endforeach ()
+# Files describe the written data, not just any memory content
+sim_exec ("write ${TestDataDir}/st10f269/write/random" 0)
+sim_exec ("verify read.s28" 9)
+sim_exec ("verify read.s37" 9)
@@ -0,0 +1,42 @@
+# Station programming two simulated boards which appear in a watched
+# directory after it started. Each board gets its own value of a counter
+# patch.
+#
+# Variables: TestProgram, Simulator, StationDir, InputFile
+
+set (PatchAddress 8)
+
+file (REMOVE_RECURSE ${StationDir})
+file (MAKE_DIRECTORY ${StationDir})
+
+# Simulators run while the station writes to the pipe, they end with it
+execute_process (
+  COMMAND ${TestProgram} station -s 230400 -d ${StationDir} -n 2
+          --patch ${PatchAddress}={5:2} tty* ${InputFile}
+  COMMAND sh -c "sleep 1; ${Simulator} -s ${StationDir}/flashA -l ${StationDir}/ttyA -- sh -c 'sleep 1; ${Simulator} -s ${StationDir}/flashB -l ${StationDir}/ttyB -- cat'"
+  RESULT_VARIABLE RESULTS
+  TIMEOUT 120
+  )
+list (GET RESULTS 0 STATION_RESULT)
+if (NOT "${STATION_RESULT}" STREQUAL "0")
+  message (FATAL_ERROR "Unexpected exit code of station ${STATION_RESULT}, expected 0")
+endif ()
+
+# Data of the file with the counter of each board over them
+file (READ ${InputFile} DATA HEX)
+string (SUBSTRING "${DATA}" 0 16 HEAD)
+string (SUBSTRING "${DATA}" 20 -1 TAIL)
+foreach (BOARD A B)
+  file (READ ${StationDir}/flash${BOARD} FLASH LIMIT 16 HEX)
+  if ("${FLASH}" STREQUAL "${HEAD}0500${TAIL}")
+    list (APPEND COUNTERS 5)
+  elseif ("${FLASH}" STREQUAL "${HEAD}0600${TAIL}")
+    list (APPEND COUNTERS 6)
+  else ()
+    message (FATAL_ERROR "Board ${BOARD} has data ${FLASH}, expected ${HEAD}XXXX${TAIL}")
+  endif ()
+endforeach ()
+list (SORT COUNTERS)
+if (NOT "${COUNTERS}" STREQUAL "5;6")
+  message (FATAL_ERROR "Boards got counters ${COUNTERS}, expected 5 and 6")
+endif ()
@@ -0,0 +1,19 @@
+# Verify passes for the written data and reports differences per block when
+# the flash changed after the write
+
+include (${SimFunctions})
+
+set (Reference ${TestDataDir}/st10f269/write/random)
+
+sim_exec ("write ${Reference}" 0)
+sim_exec ("verify ${Reference}" 0)
+
+sim_modify_flash (${TestDataDir}/multi/16B.bin 16)
+sim_modify_flash (${TestDataDir}/multi/16B.bin 32768)
+sim_exec ("verify ${Reference}" 9)
+sim_expect_output ("Block 0: 16 bytes differ in 1 ranges: 0x10-0x1F")
+sim_expect_output ("Block 3: 16 bytes differ in 1 ranges: 0x8000-0x800F")
+sim_expect_output ("Memory differs from reference in 32 bytes")
+if ("${OUTPUT}" MATCHES "Block [1245]")
+  message (FATAL_ERROR "Blocks which do not differ are reported")
+endif ()
@@ -0,0 +1,524 @@
+#include "Simulator.hpp"
+
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#include <termios.h>
+#include <stdio.h>
+
+#include <iostream>
+#include <thread>
+
+using std::cerr;
+using std::endl;
+
+#define BOOTSTRAP_ACK     0xD5
+#define SHELL_ACK         0xAB
+#define FW_1_LENGTH       32
+#define FW_LENGTH         2048
+#define BLOCK_LENGTH      1024
+#define ERASED_BYTE       0xFF
+
+#define CMD_PING          0x00
+#define CMD_ERASE_BLOCKS  0x01
+#define CMD_READ          0x02
+#define CMD_WRITE         0x03
+#define CMD_IDENTIFY      0x04
+#define CMD_ERASE_CHIP    0x05
+
+#define RET_BAD_ECHO      0x21
+#define RET_WRITE_ERROR   0x31
+
+// Output is passed to the line in chunks of this size when it is modelled
+#define LINE_CHUNK        64
+
+// Thrown when the other side closes the line
+struct line_closed_t { };
+
+static const sim_model_t models[] = {
+    { "st10f168", 0x0400, 0x0A80, { 16, 48, 96, 96 } },
+    { "st10f269", 0x0401, 0x10D0, { 16, 8, 8, 32, 64, 64, 64 } },
+};
+
+CSimulator::CSimulator(int fd, int ttyFd, const sim_model_t & model)
+    : mFd(fd), mTtyFd(ttyFd), mModel(model), mState(STATE_BOOTSTRAP), mLoads(0), mVerbose(false),
+      mWeakWord(-1), mModelLine(false), mEraseTimeMs(0), mProgramTimeUs(0), mProgramDebt(0), mVirtualTime(false),
+      mBusyTime(0), mInPos(0), mInLength(0)
+{
+    uint32_t start = 0;
+    list<uint32_t>::const_iterator it;
+    for (it = mModel.blockSizes.begin(); it != mModel.blockSizes.end(); ++it) {
+        mBlockStarts.push_back(start);
+        start += *it * 1024;
+    }
+    mBlockStarts.push_back(start);
+    mFlash.assign(start, ERASED_BYTE);
+    mLineFree = chrono::steady_clock::now();
+}
+
+bool
+CSimulator::findModel(const string & name, sim_model_t & model)
+{
+    for (size_t i = 0; i < sizeof(models) / sizeof(models[0]); ++i) {
+        if (models[i].name == name) {
+            model = models[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+void
+CSimulator::setStateFile(const string & path)
+{
+    mStateFile = path;
+    loadState();
+}
+
+void
+CSimulator::setModelLine(bool b)
+{
+    mModelLine = b;
+}
+
+void
+CSimulator::setEraseTime(int ms)
+{
+    mEraseTimeMs = ms;
+}
+
+void
+CSimulator::setProgramTime(int us)
+{
+    mProgramTimeUs = us;
+}
+
+void
+CSimulator::setVerbose(bool b)
+{
+    mVerbose = b;
+}
+
+void
+CSimulator::setWeakWord(uint32_t address)
+{
+    mWeakWord = address & ~1u;
+}
+
+void
+CSimulator::setShellLoaded()
+{
+    mState = STATE_SHELL;
+}
+
+void
+CSimulator::setVirtualTime(bool b)
+{
+    mVirtualTime = b;
+}
+
+chrono::microseconds
+CSimulator::getBusyTime() const
+{
+    return mBusyTime;
+}
+
+void
+CSimulator::log(const string & s)
+{
+    if (mVerbose)
+        cerr << "st10sim: " << s << endl;
+}
+
+// -----------------------------------------------------------------------------
+//  Line
+// -----------------------------------------------------------------------------
+
+uint8_t
+CSimulator::recByte()
+{
+    if (mInPos == mInLength) {
+        // MCU waits for data, everything sent so far must reach the host
+        flush();
+        ssize_t r;
+        do {
+            r = ::read(mFd, mIn, sizeof(mIn));
+        } while ((r < 0) && (errno == EINTR));
+        if (r <= 0)
+            throw line_closed_t();
+        mInPos = 0;
+        mInLength = r;
+    }
+    return mIn[mInPos++];
+}
+
+uint16_t
+CSimulator::recWord()
+{
+    uint16_t w = recByte();
+    w |= ((uint16_t) recByte()) << 8;
+    return w;
+}
+
+bool
+CSimulator::recSafe(uint16_t & w)
+{
+    // Echo, compare with the second copy and send the result
+    w = recWord();
+    sendWord(w);
+    uint16_t r = (recWord() == w) ? 0 : RET_BAD_ECHO;
+    sendWord(r);
+    return r == 0;
+}
+
+void
+CSimulator::sendByte(uint8_t b)
+{
+    mOut.push_back(b);
+    if (mOut.size() >= 4096)
+        flush();
+}
+
+void
+CSimulator::sendWord(uint16_t w)
+{
+    sendByte(w & 0xFF);
+    sendByte(w >> 8);
+}
+
+int
+CSimulator::getLineSpeed()
+{
+    static const struct { speed_t s; int bd; } speeds[] = {
+        { B1200, 1200 }, { B2400, 2400 }, { B4800, 4800 }, { B9600, 9600 },
+        { B19200, 19200 }, { B38400, 38400 }, { B57600, 57600 }, { B115200, 115200 },
+        { B230400, 230400 },
+    };
+    struct termios t;
+
+    // Speed is set by the host on its side of the pseudo-terminal
+    if ((mTtyFd == -1) || (tcgetattr(mTtyFd, &t) != 0))
+        return 0;
+    speed_t s = cfgetospeed(&t);
+    for (size_t i = 0; i < sizeof(speeds) / sizeof(speeds[0]); ++i) {
+        if (speeds[i].s == s)
+            return speeds[i].bd;
+    }
+    return 0;
+}
+
+void
+CSimulator::flush()
+{
+    int bd = mModelLine ? getLineSpeed() : 0;
+    size_t chunk = bd ? LINE_CHUNK : mOut.size();
+
+    for (size_t i = 0; i < mOut.size(); ) {
+        size_t n = (mOut.size() - i < chunk) ? mOut.size() - i : chunk;
+        if (bd) {
+            // Start bit, 8 data bits and stop bit for each byte
+            std::this_thread::sleep_until(mLineFree);
+            chrono::steady_clock::time_point now = chrono::steady_clock::now();
+            if (mLineFree < now)
+                mLineFree = now;
+            mLineFree += chrono::microseconds(n * 10 * 1000000 / bd);
+        }
+        ssize_t w = ::write(mFd, mOut.data() + i, n);
+        if ((w < 0) && (errno == EINTR))
+            continue;
+        if (w <= 0)
+            throw line_closed_t();
+        i += w;
+    }
+    mOut.clear();
+}
+
+// -----------------------------------------------------------------------------
+//  Flash memory
+// -----------------------------------------------------------------------------
+
+void
+CSimulator::eraseBlock(unsigned int block)
+{
+    memset(mFlash.data() + mBlockStarts[block], ERASED_BYTE, mBlockStarts[block + 1] - mBlockStarts[block]);
+}
+
+bool
+CSimulator::program(uint32_t address, uint16_t w)
+{
+    if (address + 1 >= mFlash.size())
+        return false;
+    uint16_t old = mFlash[address] | (mFlash[address + 1] << 8);
+    // Programming only clears bits, setting one fails as on the real part
+    if ((old & w) != w)
+        return false;
+    if (address == mWeakWord) {
+        log("Word at " + std::to_string(address) + " not programmed");
+        mWeakWord = -1;
+        delayProgram();
+        return true;
+    }
+    mFlash[address] = w & 0xFF;
+    mFlash[address + 1] = w >> 8;
+    delayProgram();
+    return true;
+}
+
+void
+CSimulator::delayProgram()
+{
+    if (mProgramTimeUs == 0)
+        return;
+    mBusyTime += chrono::microseconds(mProgramTimeUs);
+    if (mVirtualTime)
+        return;
+    // Sleep in larger steps, timer resolution is far above word time
+    mProgramDebt += chrono::microseconds(mProgramTimeUs);
+    if (mProgramDebt >= chrono::milliseconds(1)) {
+        flush();
+        std::this_thread::sleep_for(mProgramDebt);
+        mProgramDebt = chrono::microseconds(0);
+    }
+}
+
+void
+CSimulator::busy(chrono::microseconds t)
+{
+    mBusyTime += t;
+    if (mVirtualTime)
+        return;
+    flush();
+    std::this_thread::sleep_for(t);
+}
+
+bool
+CSimulator::checkCount(uint32_t & count, uint32_t & blockCount)
+{
+    // Status and remaining count after each block and at the end
+    count -= 2;
+    if (count != 0) {
+        blockCount -= 2;
+        if (blockCount != 0)
+            return false;
+    }
+    sendWord(0);
+    blockCount = BLOCK_LENGTH;
+    sendWord(count & 0xFFFF);
+    sendWord(count >> 16);
+    return count == 0;
+}
+
+void
+CSimulator::loadState()
+{
+    FILE *f = fopen(mStateFile.c_str(), "rb");
+    if (f == NULL)
+        return;
+    vector<uint8_t> d(mFlash.size() + 1);
+    size_t n = fread(d.data(), 1, d.size(), f);
+    fclose(f);
+    if (n == mFlash.size())
+        memcpy(mFlash.data(), d.data(), n);
+    else
+        log("State file " + mStateFile + " does not match flash size, starting erased");
+}
+
+void
+CSimulator::saveState()
+{
+    if (mStateFile.empty())
+        return;
+    // Replace the file at once, simulator may be killed anytime
+    string tmp = mStateFile + ".tmp";
+    FILE *f = fopen(tmp.c_str(), "wb");
+    if (f == NULL) {
+        log("Cannot write state file " + tmp);
+        return;
+    }
+    bool ok = (fwrite(mFlash.data(), 1, mFlash.size(), f) == mFlash.size());
+    ok = (fclose(f) == 0) && ok;
+    if (ok)
+        rename(tmp.c_str(), mStateFile.c_str());
+}
+
+// -----------------------------------------------------------------------------
+//  Firmware
+// -----------------------------------------------------------------------------
+
+void
+CSimulator::run()
+{
+    try {
+        for (;;) {
+            switch (mState) {
+            case STATE_BOOTSTRAP:
+                bootstrap();
+                break;
+            case STATE_STAGE_1:
+                stage1();
+                break;
+            case STATE_SHELL:
+                shell();
+                break;
+            }
+        }
+    } catch (line_closed_t &) {
+        log("Line closed");
+    }
+}
+
+void
+CSimulator::bootstrap()
+{
+    // Bootstrap loader answers zero byte and loads 32 bytes of stage 1
+    if (recByte() != 0)
+        return;
+    log("Bootstrap loader acknowledged");
+    sendByte(BOOTSTRAP_ACK);
+    for (int i = 0; i < FW_1_LENGTH; ++i)
+        recByte();
+    mState = STATE_STAGE_1;
+    mLoads = 0;
+}
+
+void
+CSimulator::stage1()
+{
+    for (int i = 0; i < FW_LENGTH; ++i)
+        recByte();
+    // Host loads ident firmware first, it returns back to stage 1
+    if (++mLoads == 1) {
+        log("Ident firmware loaded");
+        cmdIdentify();
+    } else {
+        log("Stage 2 firmware loaded");
+        sendWord(0);
+        mState = STATE_SHELL;
+    }
+}
+
+void
+CSimulator::shell()
+{
+    uint8_t b = recByte();
+    if (b == CMD_PING) {
+        sendByte(SHELL_ACK);
+        return;
+    }
+    // Command is received safely
+    sendByte(b);
+    if (recByte() != b) {
+        sendByte(RET_BAD_ECHO);
+        return;
+    }
+    sendByte(0);
+
+    switch (b) {
+    case CMD_ERASE_BLOCKS:
+        cmdEraseBlocks();
+        break;
+    case CMD_READ:
+        cmdRead();
+        break;
+    case CMD_WRITE:
+        cmdWrite();
+        break;
+    case CMD_IDENTIFY:
+        cmdIdentify();
+        break;
+    case CMD_ERASE_CHIP:
+        cmdEraseChip();
+        break;
+    default:
+        break;
+    }
+}
+
+void
+CSimulator::cmdEraseBlocks()
+{
+    uint16_t config, mask;
+    if (!recSafe(config) || !recSafe(mask))
+        return;
+
+    int n = 0;
+    string blocks;
+    for (unsigned int i = 0; i + 1 < mBlockStarts.size(); ++i) {
+        if (mask & (1 << i)) {
+            eraseBlock(i);
+            blocks += (n == 0 ? " " : ",") + std::to_string(i);
+            ++n;
+        }
+    }
+    log("Erased blocks" + blocks);
+    busy(chrono::milliseconds(n * mEraseTimeMs));
+    saveState();
+    sendWord(0);
+}
+
+void
+CSimulator::cmdEraseChip()
+{
+    uint16_t config;
+    if (!recSafe(config))
+        return;
+
+    for (unsigned int i = 0; i + 1 < mBlockStarts.size(); ++i)
+        eraseBlock(i);
+    log("Erased chip");
+    busy(chrono::milliseconds((mBlockStarts.size() - 1) * mEraseTimeMs));
+    saveState();
+    sendWord(0);
+}
+
+void
+CSimulator::cmdRead()
+{
+    uint16_t config, lo, hi;
+    if (!recSafe(config) || !recSafe(lo) || !recSafe(hi))
+        return;
+
+    uint32_t count = lo | (hi << 16);
+    uint32_t blockCount = BLOCK_LENGTH;
+    log("Reading " + std::to_string(count) + " bytes");
+    for (uint32_t a = 0; ; a += 2) {
+        uint16_t w = 0xFFFF;
+        if (a + 1 < mFlash.size())
+            w = mFlash[a] | (mFlash[a + 1] << 8);
+        sendWord(w);
+        if (checkCount(count, blockCount))
+            break;
+    }
+}
+
+void
+CSimulator::cmdWrite()
+{
+    uint16_t config, lo, hi;
+    if (!recSafe(config) || !recSafe(lo) || !recSafe(hi))
+        return;
+
+    uint32_t count = lo | (hi << 16);
+    uint32_t blockCount = BLOCK_LENGTH;
+    log("Writing " + std::to_string(count) + " bytes");
+    for (uint32_t a = 0; ; a += 2) {
+        if (!program(a, recWord())) {
+            log("Write error at " + std::to_string(a));
+            saveState();
+            sendWord(RET_WRITE_ERROR);
+            return;
+        }
+        if (checkCount(count, blockCount))
+            break;
+    }
+    // Host may end the simulator as soon as it has the final status
+    saveState();
+    flush();
+}
+
+void
+CSimulator::cmdIdentify()
+{
+    sendWord(mModel.idmanuf);
+    sendWord(mModel.idchip);
+}
@@ -0,0 +1,114 @@
+#ifndef SIMULATOR_HPP
+#define SIMULATOR_HPP 1
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <list>
+#include <chrono>
+
+using std::string;
+using std::vector;
+using std::list;
+namespace chrono = std::chrono;
+
+// Model of simulated MCU, as identified by the ident firmware
+typedef struct {
+    string name;
+    uint16_t idmanuf;
+    uint16_t idchip;
+    list<uint32_t> blockSizes;  // KB, as given by IMcuSpecifics
+} sim_model_t;
+
+// Behaviour of the ST10 bootstrap loader, stage 1 loader, ident firmware
+// and stage 2 shell on the MCU side of a serial line. Flash memory is kept
+// in memory and optionally in a state file which survives the simulator.
+class CSimulator {
+private:
+    typedef enum {
+        STATE_BOOTSTRAP,  // Waiting for zero byte, then for stage 1
+        STATE_STAGE_1,    // Loading firmware to RAM
+        STATE_SHELL       // Stage 2 firmware accepts commands
+    } state_t;
+
+    int mFd;
+    int mTtyFd;
+    sim_model_t mModel;
+    vector<uint8_t> mFlash;
+    vector<uint32_t> mBlockStarts;
+    string mStateFile;
+    state_t mState;
+    int mLoads;
+    bool mVerbose;
+    // Address of a word the first programming of which has no effect, -1
+    // when all words are good
+    int64_t mWeakWord;
+
+    // Modelled timing, zero means as fast as possible
+    bool mModelLine;
+    int mEraseTimeMs;
+    int mProgramTimeUs;
+    chrono::steady_clock::time_point mLineFree;
+    chrono::microseconds mProgramDebt;
+    // Erase and program time is only counted, not waited for
+    bool mVirtualTime;
+    chrono::microseconds mBusyTime;
+
+    vector<uint8_t> mOut;
+    uint8_t mIn[4096];
+    size_t mInPos;
+    size_t mInLength;
+
+    uint8_t recByte();
+    uint16_t recWord();
+    bool recSafe(uint16_t & w);
+    void sendByte(uint8_t b);
+    void sendWord(uint16_t w);
+    void flush();
+    int getLineSpeed();
+
+    bool checkCount(uint32_t & count, uint32_t & blockCount);
+    void eraseBlock(unsigned int block);
+    bool program(uint32_t address, uint16_t w);
+    void delayProgram();
+    void busy(chrono::microseconds t);
+
+    void bootstrap();
+    void stage1();
+    void shell();
+    void cmdEraseBlocks();
+    void cmdEraseChip();
+    void cmdRead();
+    void cmdWrite();
+    void cmdIdentify();
+
+    void loadState();
+    void saveState();
+    void log(const string & s);
+
+public:
+    // Line is a descriptor of pseudo-terminal master or of a socket, tty
+    // is the descriptor of the terminal whose speed is modelled or -1
+    CSimulator(int fd, int ttyFd, const sim_model_t & model);
+
+    static bool findModel(const string & name, sim_model_t & model);
+
+    void setStateFile(const string & path);
+    void setModelLine(bool b);
+    void setEraseTime(int ms);
+    void setProgramTime(int us);
+    void setVerbose(bool b);
+    // First write of the word at address leaves it unchanged while the
+    // shell reports success, as a weak cell which needs a repair
+    void setWeakWord(uint32_t address);
+    // Start with stage 2 firmware already loaded
+    void setShellLoaded();
+    void setVirtualTime(bool b);
+    // Modelled erase and program time spent so far
+    chrono::microseconds getBusyTime() const;
+
+    // Serve the line until it is closed
+    void run();
+};
+
+#endif
@@ -0,0 +1,168 @@
+// Simulator of ST10 MCU with stage 2 shell on a pseudo-terminal. The host
+// program talks to the slave side exactly as to a serial port connected
+// to a board in bootstrap mode.
+//
+//   st10sim [-m MODEL] [-s STATEFILE] [-l LINK] [-t] [-E MS] [-W US] [-v]
+//           [-- COMMAND [ARG]...]
+//
+// Without COMMAND the name of the terminal is printed and the line is
+// served until the simulator is killed. With COMMAND the simulator runs it
+// and exits with its exit code.
+
+#include "Simulator.hpp"
+
+#include <unistd.h>
+#include <stdlib.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <string.h>
+#include <signal.h>
+#include <termios.h>
+#include <sys/wait.h>
+
+#include <iostream>
+
+using std::cout;
+using std::cerr;
+using std::endl;
+
+static void
+usage()
+{
+    cerr << "Usage: st10sim [-m st10f168|st10f269] [-s STATEFILE] [-l LINK] [-t]" << endl
+         << "               [-E MS] [-W US] [-F ADDRESS] [-v] [-- COMMAND [ARG]...]" << endl
+         << "  -m MODEL      Simulated MCU, default st10f269" << endl
+         << "  -s STATEFILE  Keep flash content in the file between runs" << endl
+         << "  -l LINK       Create symbolic link LINK to the terminal" << endl
+         << "  -t            Model UART byte time of data sent by MCU at the speed" << endl
+         << "                set by the host" << endl
+         << "  -E MS         Modelled erase time of one block" << endl
+         << "  -W US         Modelled program time of one word" << endl
+         << "  -F ADDRESS    First write of the word at decimal ADDRESS has no effect" << endl
+         << "  -v            Print simulated events" << endl;
+    exit(2);
+}
+
+static int
+parseNumber(const char *s)
+{
+    char *e;
+    long n = strtol(s, &e, 10);
+    if ((*s == '\0') || (*e != '\0') || (n < 0) || (n > 1000000))
+        usage();
+    return n;
+}
+
+int
+main(int argc, char **argv)
+{
+    sim_model_t model;
+    string stateFile;
+    string link;
+    bool modelLine = false;
+    int eraseTime = 0;
+    int programTime = 0;
+    int weakWord = -1;
+    bool verbose = false;
+    char **command = 0;
+
+    CSimulator::findModel("st10f269", model);
+    for (int i = 1; i < argc; ++i) {
+        string a = argv[i];
+        bool hasArg = (i + 1 < argc);
+        if (a == "--") {
+            if (!hasArg)
+                usage();
+            command = argv + i + 1;
+            break;
+        } else if (a == "-t") {
+            modelLine = true;
+        } else if (a == "-v") {
+            verbose = true;
+        } else if ((a == "-m") && hasArg) {
+            if (!CSimulator::findModel(argv[++i], model))
+                usage();
+        } else if ((a == "-s") && hasArg) {
+            stateFile = argv[++i];
+        } else if ((a == "-l") && hasArg) {
+            link = argv[++i];
+        } else if ((a == "-E") && hasArg) {
+            eraseTime = parseNumber(argv[++i]);
+        } else if ((a == "-W") && hasArg) {
+            programTime = parseNumber(argv[++i]);
+        } else if ((a == "-F") && hasArg) {
+            weakWord = parseNumber(argv[++i]);
+        } else {
+            usage();
+        }
+    }
+
+    int master = posix_openpt(O_RDWR | O_NOCTTY);
+    if ((master == -1) || (grantpt(master) != 0) || (unlockpt(master) != 0)) {
+        cerr << "st10sim: Cannot create pseudo-terminal: " << strerror(errno) << endl;
+        return 1;
+    }
+    string slaveName = ptsname(master);
+
+    // Slave stays open, closing it by the host must not end the line. Raw
+    // mode is set until the host sets its own options.
+    int slave = open(slaveName.c_str(), O_RDWR | O_NOCTTY);
+    struct termios t;
+    if ((slave == -1) || (tcgetattr(slave, &t) != 0)) {
+        cerr << "st10sim: Cannot open " << slaveName << ": " << strerror(errno) << endl;
+        return 1;
+    }
+    cfmakeraw(&t);
+    tcsetattr(slave, TCSANOW, &t);
+
+    if (!link.empty()) {
+        unlink(link.c_str());
+        if (symlink(slaveName.c_str(), link.c_str()) != 0) {
+            cerr << "st10sim: Cannot create link " << link << ": " << strerror(errno) << endl;
+            return 1;
+        }
+    }
+
+    CSimulator sim(master, slave, model);
+    sim.setModelLine(modelLine);
+    sim.setEraseTime(eraseTime);
+    sim.setProgramTime(programTime);
+    sim.setVerbose(verbose);
+    if (weakWord != -1)
+        sim.setWeakWord(weakWord);
+    if (!stateFile.empty())
+        sim.setStateFile(stateFile);
+
+    if (command == 0) {
+        cout << slaveName << endl;
+        sim.run();
+        return 0;
+    }
+
+    // Simulator serves the line in a child process while command runs
+    pid_t s = fork();
+    if (s == 0) {
+        sim.run();
+        _exit(0);
+    }
+    pid_t c = fork();
+    if (c == 0) {
+        close(master);
+        close(slave);
+        execvp(command[0], command);
+        cerr << "st10sim: Cannot run " << command[0] << ": " << strerror(errno) << endl;
+        _exit(127);
+    }
+
+    int status = 0;
+    while ((waitpid(c, &status, 0) == -1) && (errno == EINTR))
+        ;
+    kill(s, SIGKILL);
+    waitpid(s, 0, 0);
+    if (!link.empty())
+        unlink(link.c_str());
+
+    if (WIFEXITED(status))
+        return WEXITSTATUS(status);
+    return 128 + WTERMSIG(status);
+}
@@ -230,6 +230,7 @@ int main(argc, argv)
     char *cp, *clabel, *tlabel, *cppNameSpace, opt;
     FILE *in = stdin, *out = stdout;
 
+    clabel = tlabel = cppNameSpace = "";
     if (argc > 1) {
         i = strlen(argv[1]);
         clabel = argv[1] + i;